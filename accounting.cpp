@@ -0,0 +1,94 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "accounting.h"
+#include <fstream>
+#include <iomanip>
+#include <cstdio>
+#include "process.h"
+#include "cpusampler.h"
+#include "metrics.h"
+
+void Accounting::add(Usage& usage, CpuSampler& sampler)
+{
+    usage.seconds += sampler.getLastSeconds();
+    usage.cpuSeconds += sampler.getLastCpuSeconds();
+    usage.switches += sampler.getLastSwitches();
+}
+
+void Accounting::addForeground(const std::string& name, CpuSampler& sampler)
+{
+    add(applications_[name].foreground, sampler);
+}
+
+void Accounting::addBackground(const std::string& name, CpuSampler& sampler)
+{
+    add(applications_[name].background, sampler);
+}
+
+void Accounting::stopped(Process& process)
+{
+    stopped_.insert({process.getPid(), {process.getName(), Metrics::now()}});
+}
+
+void Accounting::resumed(Process& process)
+{
+    auto stop = stopped_.find(process.getPid());
+    if(stop == stopped_.end()) return;
+    applications_[stop->second.name].stoppedSeconds += (Metrics::now() - stop->second.time)/1000000.0;
+    stopped_.erase(stop);
+}
+
+bool Accounting::write(const std::string& fileName)
+{
+    const std::string tempName = fileName + ".tmp";
+    std::fstream file(tempName, std::fstream::out | std::fstream::trunc);
+    if(!file.is_open()) return false;
+    
+    //applications that are stopped right now are counted up to this point
+    uint64_t now = Metrics::now();
+    std::map<std::string, double> stoppedSeconds;
+    for(const auto& stop : stopped_) stoppedSeconds[stop.second.name] += (now - stop.second.time)/1000000.0;
+    
+    //what an application did in the background before being stopped is what it would have kept doing
+    file<<"# name foreground_cpu_percent foreground_switches_per_second background_cpu_percent "
+          "background_switches_per_second stopped_seconds cpu_seconds_saved switches_saved\n";
+    file<<std::fixed<<std::setprecision(2);
+    for(const auto& application : applications_)
+    {
+        const Application& usage = application.second;
+        auto rate = [](double value, double seconds){return seconds > 0 ? value/seconds : 0.0;};
+        double stopped = usage.stoppedSeconds + stoppedSeconds[application.first];
+        double backgroundCpu = rate(usage.background.cpuSeconds, usage.background.seconds);
+        double backgroundSwitches = rate(usage.background.switches, usage.background.seconds);
+        std::string name = application.first;
+        for(auto& ch : name) if(ch == ' ') ch = '_';
+        file<<name<<' '
+            <<rate(usage.foreground.cpuSeconds, usage.foreground.seconds)*100<<' '
+            <<rate(usage.foreground.switches, usage.foreground.seconds)<<' '
+            <<backgroundCpu*100<<' '
+            <<backgroundSwitches<<' '
+            <<stopped<<' '
+            <<backgroundCpu*stopped<<' '
+            <<backgroundSwitches*stopped<<'\n';
+    }
+    file.close();
+    if(file.fail()) return false;
+    return std::rename(tempName.c_str(), fileName.c_str()) == 0;
+}
@@ -0,0 +1,64 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+#include <sys/types.h>
+
+class Process;
+class CpuSampler;
+
+class Accounting
+{
+private:
+    struct Usage
+    {
+        double seconds = 0;
+        double cpuSeconds = 0;
+        double switches = 0;
+    };
+    
+    struct Application
+    {
+        Usage foreground;
+        Usage background;
+        double stoppedSeconds = 0;
+    };
+    
+    struct Stop
+    {
+        std::string name;
+        uint64_t time;
+    };
+    
+    std::map<std::string, Application> applications_;
+    std::unordered_map<pid_t, Stop> stopped_;
+    
+    static void add(Usage& usage, CpuSampler& sampler);
+    
+public:
+    void addForeground(const std::string& name, CpuSampler& sampler);
+    void addBackground(const std::string& name, CpuSampler& sampler);
+    void stopped(Process& process);
+    void resumed(Process& process);
+    bool write(const std::string& fileName);
+};
@@ -19,11 +19,24 @@
 
 #pragma once
 #include<argp.h>
+#include<cstring>
 
 struct Config
 {
     bool ignoreClientMachine = false;
     int  timeoutSecs = 10;
+    bool procConnector = false;
+    bool cgroupFreezer = false;
+    int  metricsIntervalSecs = 0;
+    int  reclaimDelaySecs = -1;
+    int  reclaimIntervalSecs = 5;
+    bool prefault = false;
+    int  idleDelaySecs = -1;
+    int  throttleDelaySecs = -1;
+    int  throttlePercent = 10;
+    double cpuThreshold = 0;
+    int  cpuRecheckSecs = 60;
+    bool accounting = false;
 };
 
 const char *argp_program_version = "1.0.6";
@@ -35,6 +48,18 @@ static struct argp_option options[] =
 {
   {"ignore-client-machine",  'i', 0,      0,  "Also stop programs associated with windows that fail to set WM_CLIENT_MACHINE" },
   {"timout", 't', "seconds",      0,  "Timeout to give program to close its last window before stoping it" },
+  {"backend", 'b', "backend",      0,  "How to stop programs: signal (SIGSTOP, default) or cgroup (cgroup v2 freezer)" },
+  {"metrics-interval", 'm', "seconds",      0,  "Write sigstoped.prom to the config directory at this interval, it is also written on SIGUSR2" },
+  {"reclaim", 'c', "seconds",      0,  "Page out the memory of stopped programs this many seconds after stopping them" },
+  {"reclaim-interval", 'R', "seconds",      0,  "Minimum time between two reclaims, defaults to 5" },
+  {"prefault", 'f', 0,      0,  "Start swapping in the hottest memory of stopped programs when they are resumed" },
+  {"idle-after", 'I', "seconds",      0,  "Move programs to idle cpu and io priority this long after they lose focus, before stoping them" },
+  {"throttle-after", 'T', "seconds",      0,  "Limit the cpu time of programs this long after they lose focus, requires the cgroup backend" },
+  {"throttle", 'P', "percent",      0,  "Cpu limit used by --throttle-after, defaults to 10" },
+  {"cpu-threshold", 'u', "percent",      0,  "Only stop programs that use more than this share of a cpu while in the background, can not be combined with --idle-after or --throttle-after" },
+  {"cpu-recheck", 'e', "seconds",      0,  "How often programs left running by --cpu-threshold are checked again, defaults to 60" },
+  {"accounting", 'a', 0,      0,  "Record the cpu time and context switches of blacklisted programs and write the estimated savings to the config directory" },
+  {"proc-connector", 'p', 0,      0,  "Track processes via the kernel proc connector instead of scanning /proc, requires CAP_NET_ADMIN" },
   { 0 }
 };
 
@@ -50,6 +75,51 @@ error_t parse_opt (int key, char *arg, struct argp_state *state)
         case 't':
         config->timeoutSecs = atol(arg);
         break;
+        case 'b':
+        if(strcmp(arg, "cgroup") == 0) config->cgroupFreezer = true;
+        else if(strcmp(arg, "signal") == 0) config->cgroupFreezer = false;
+        else argp_error(state, "unknown backend %s", arg);
+        break;
+        case 'm':
+        config->metricsIntervalSecs = atol(arg);
+        break;
+        case 'c':
+        config->reclaimDelaySecs = atol(arg);
+        break;
+        case 'R':
+        config->reclaimIntervalSecs = atol(arg);
+        break;
+        case 'f':
+        config->prefault = true;
+        break;
+        case 'I':
+        config->idleDelaySecs = atol(arg);
+        break;
+        case 'T':
+        config->throttleDelaySecs = atol(arg);
+        break;
+        case 'P':
+        config->throttlePercent = atol(arg);
+        if(config->throttlePercent < 1 || config->throttlePercent > 100) argp_error(state, "throttle must be between 1 and 100 percent");
+        break;
+        case 'u':
+        config->cpuThreshold = atof(arg);
+        break;
+        case 'e':
+        config->cpuRecheckSecs = atol(arg);
+        if(config->cpuRecheckSecs < 1) argp_error(state, "cpu-recheck must be at least 1 second");
+        break;
+        case 'a':
+        config->accounting = true;
+        break;
+        case 'p':
+        config->procConnector = true;
+        break;
+        case ARGP_KEY_END:
+        //demoted programs are held below their real cpu usage, so it can not be measured while they are
+        if(config->cpuThreshold > 0 && (config->idleDelaySecs >= 0 || config->throttleDelaySecs >= 0))
+            argp_error(state, "cpu-threshold can not be combined with idle-after or throttle-after");
+        break;
         default:
         return ARGP_ERR_UNKNOWN;
     }
@@ -0,0 +1,133 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "fakeproctree.h"
+#include <iostream>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+static bool writeFile(const std::string& path, const char* data, size_t length)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0) return false;
+    bool ret = write(fd, data, length) == static_cast<ssize_t>(length);
+    close(fd);
+    return ret;
+}
+
+FakeProcTree::~FakeProcTree()
+{
+    remove();
+}
+
+const char* FakeProcTree::shapeName(Shape shape)
+{
+    return shape == SHAPE_WIDE ? "wide" : "deep";
+}
+
+bool FakeProcTree::addProcess(pid_t pid, pid_t ppid, const char* name, const std::string& children)
+{
+    const std::string dir = root_ + "/" + std::to_string(pid);
+    const std::string taskDir = dir + "/task/" + std::to_string(pid);
+    if(mkdir(dir.c_str(), 0755) < 0 || mkdir((dir + "/task").c_str(), 0755) < 0 || mkdir(taskDir.c_str(), 0755) < 0) 
+        return false;
+    
+    //every field up to starttime is present, as in proc(5)
+    char stat[256];
+    int length = snprintf(stat, sizeof(stat), "%d (%s) S %d %d %d 0 -1 4194304 0 0 0 0 %d %d 0 0 20 0 1 0 %d 0 0\n",
+                          pid, name, ppid, pid, ppid == 0 ? pid : APP_PID, pid%7, pid%3, 1000+pid);
+    std::string cmdline = std::string(name) + '\0';
+    return writeFile(dir + "/stat", stat, length) &&
+           writeFile(dir + "/cmdline", cmdline.c_str(), cmdline.size()) &&
+           writeFile(taskDir + "/children", children.c_str(), children.size());
+}
+
+bool FakeProcTree::create(size_t count, Shape shape)
+{
+    remove();
+    if(count < 2) return false;
+    const char* tmpDir = getenv("TMPDIR");
+    std::string pattern = std::string(tmpDir ? tmpDir : "/tmp") + "/fakeprocXXXXXX";
+    if(mkdtemp(pattern.data()) == nullptr)
+    {
+        std::cerr<<"Can not create "<<pattern<<": "<<strerror(errno)<<'\n';
+        return false;
+    }
+    root_ = pattern;
+    count_ = count;
+    
+    //pids are 1 to count, init and the application come first and every other pid is a
+    //descendant of the application, either all its children or a single chain below it
+    const pid_t lastPid = count;
+    std::string initChildren = std::to_string(APP_PID) + ' ';
+    if(getpid() > lastPid) initChildren += std::to_string(getpid()) + ' ';
+    bool ok = addProcess(INIT_PID, 0, "init", initChildren);
+    
+    std::string appChildren;
+    if(shape == SHAPE_WIDE)
+    {
+        for(pid_t pid = APP_PID+1; pid <= lastPid; ++pid) appChildren += std::to_string(pid) + ' ';
+    }
+    else if(lastPid > APP_PID)
+    {
+        appChildren = std::to_string(APP_PID+1) + ' ';
+    }
+    ok = ok && addProcess(APP_PID, INIT_PID, APP_NAME, appChildren);
+    
+    for(pid_t pid = APP_PID+1; ok && pid <= lastPid; ++pid)
+    {
+        pid_t ppid = shape == SHAPE_WIDE ? APP_PID : pid-1;
+        std::string children = shape == SHAPE_DEEP && pid < lastPid ? std::to_string(pid+1) + ' ' : std::string();
+        ok = addProcess(pid, ppid, WORKER_NAME, children);
+    }
+    
+    //Process probes for the children file through self
+    if(ok && getpid() > lastPid) ok = addProcess(getpid(), INIT_PID, "procbench", std::string());
+    ok = ok && symlink(std::to_string(getpid()).c_str(), (root_ + "/self").c_str()) == 0;
+    if(!ok)
+    {
+        std::cerr<<"Can not populate "<<root_<<": "<<strerror(errno)<<'\n';
+        remove();
+    }
+    return ok;
+}
+
+void FakeProcTree::remove()
+{
+    if(root_.empty()) return;
+    std::error_code error;
+    std::filesystem::remove_all(root_, error);
+    root_.clear();
+    count_ = 0;
+}
+
+const std::string& FakeProcTree::getRoot()
+{
+    return root_;
+}
+
+size_t FakeProcTree::getCount()
+{
+    return count_;
+}
@@ -0,0 +1,53 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <string>
+#include <sys/types.h>
+
+//builds a directory that Process can use as its proc root, with one application
+//whose descendants are laid out in the requested shape
+class FakeProcTree
+{
+public:
+    enum Shape
+    {
+        SHAPE_WIDE,
+        SHAPE_DEEP
+    };
+    
+    static constexpr pid_t INIT_PID = 1;
+    static constexpr pid_t APP_PID = 2;
+    static constexpr char APP_NAME[] = "app";
+    static constexpr char WORKER_NAME[] = "worker";
+    
+private:
+    std::string root_;
+    size_t count_ = 0;
+    
+    bool addProcess(pid_t pid, pid_t ppid, const char* name, const std::string& children);
+    
+public:
+    ~FakeProcTree();
+    bool create(size_t count, Shape shape);
+    void remove();
+    const std::string& getRoot();
+    size_t getCount();
+    static const char* shapeName(Shape shape);
+};
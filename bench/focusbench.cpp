@@ -0,0 +1,422 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <argp.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+
+#ifndef XVFB_PATH
+#define XVFB_PATH "Xvfb"
+#endif
+#ifndef SIGSTOPED_PATH
+#define SIGSTOPED_PATH "sigstoped"
+#endif
+
+struct BenchConfig
+{
+    int clients = 8;
+    int treeSize = 10;
+    int switches = 2000;
+    const char* daemon = SIGSTOPED_PATH;
+    const char* display = ":99";
+    const char* log = "/dev/null";
+};
+
+static char doc[] = "Runs sigstoped under Xvfb against dummy clients and measures how long it takes from a _NET_ACTIVE_WINDOW change until the focused client is continued and the previous one is stopped.";
+static char args_doc[] = "";
+
+static struct argp_option options[] = 
+{
+  {"clients", 'c', "count",      0,  "Number of dummy clients, defaults to 8" },
+  {"tree", 't', "count",      0,  "Number of child processes of every client, defaults to 10" },
+  {"switches", 's', "count",      0,  "Number of timed focus switches, defaults to 2000" },
+  {"daemon", 'd', "path",      0,  "sigstoped executable to benchmark" },
+  {"display", 'D', "display",      0,  "Display Xvfb is started on, defaults to :99" },
+  {"log", 'l', "file",      0,  "Write the output of sigstoped to this file" },
+  { 0 }
+};
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+    BenchConfig* config = reinterpret_cast<BenchConfig*>(state->input);
+    switch (key)
+    {
+        case 'c':
+        config->clients = atol(arg);
+        if(config->clients < 2) argp_error(state, "at least 2 clients are needed to switch focus");
+        break;
+        case 't':
+        config->treeSize = atol(arg);
+        if(config->treeSize < 0) argp_error(state, "tree size can not be negative");
+        break;
+        case 's':
+        config->switches = atol(arg);
+        if(config->switches < 1) argp_error(state, "switches must be at least 1");
+        break;
+        case 'd':
+        config->daemon = arg;
+        break;
+        case 'D':
+        config->display = arg;
+        break;
+        case 'l':
+        config->log = arg;
+        break;
+        default:
+        return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+static constexpr char CLIENT_NAME[] = "fbclient";
+static constexpr int STARTUP_TIMEOUT_MS = 10000;
+static constexpr int SWITCH_TIMEOUT_MS = 5000;
+
+struct Client
+{
+    pid_t pid;
+    Window wid;
+    bool stopped = false;
+    uint64_t eventTime = 0;
+};
+
+static uint64_t now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec)*1000000 + time.tv_nsec/1000;
+}
+
+static pid_t spawn(const std::vector<const char*>& argv, const std::string& home, const char* display, const char* log)
+{
+    pid_t pid = fork();
+    if(pid != 0) return pid;
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, nullptr);
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    int logFd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(logFd >= 0)
+    {
+        dup2(logFd, STDOUT_FILENO);
+        dup2(logFd, STDERR_FILENO);
+    }
+    if(!home.empty()) setenv("HOME", home.c_str(), true);
+    setenv("DISPLAY", display, true);
+    execvp(argv[0], const_cast<char* const*>(argv.data()));
+    _exit(127);
+}
+
+//a client is a process named like the blacklist entry with treeSize children that all sleep
+static pid_t spawnClient(int treeSize)
+{
+    pid_t pid = fork();
+    if(pid != 0) return pid;
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    prctl(PR_SET_NAME, CLIENT_NAME);
+    for(int i = 0; i < treeSize; ++i)
+    {
+        if(fork() == 0)
+        {
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            break;
+        }
+    }
+    while(true) pause();
+}
+
+class Bench
+{
+private:
+    int sigFd_;
+    Display* display_ = nullptr;
+    Atom netActiveWindow_;
+    Atom netWmPid_;
+    Atom netClientList_;
+    std::vector<Client> clients_;
+    pid_t daemon_ = -1;
+    
+public:
+    std::vector<uint64_t> resumeLatency;
+    std::vector<uint64_t> stopLatency;
+    
+    Bench(int sigFd): sigFd_(sigFd){}
+    
+    bool connect(const char* displayName)
+    {
+        for(int waited = 0; waited < STARTUP_TIMEOUT_MS && !display_; waited += 10)
+        {
+            display_ = XOpenDisplay(displayName);
+            if(!display_) usleep(10000);
+        }
+        if(!display_) return false;
+        netActiveWindow_ = XInternAtom(display_, "_NET_ACTIVE_WINDOW", false);
+        netWmPid_ = XInternAtom(display_, "_NET_WM_PID", false);
+        netClientList_ = XInternAtom(display_, "_NET_CLIENT_LIST", false);
+        XInternAtom(display_, "WM_CLIENT_MACHINE", false);
+        return true;
+    }
+    
+    void disconnect()
+    {
+        if(display_) XCloseDisplay(display_);
+        display_ = nullptr;
+    }
+    
+    //stands in for the window manager: one top level window per client with the properties it would set
+    void addClient(pid_t pid)
+    {
+        Client client;
+        client.pid = pid;
+        client.wid = XCreateSimpleWindow(display_, DefaultRootWindow(display_), 0, 0, 64, 64, 0, 0, 0);
+        char hostName[HOST_NAME_MAX+1] = {0};
+        gethostname(hostName, HOST_NAME_MAX);
+        char* hostNames[] = {hostName};
+        XTextProperty hostProperty;
+        XStringListToTextProperty(hostNames, 1, &hostProperty);
+        XSetWMClientMachine(display_, client.wid, &hostProperty);
+        XFree(hostProperty.value);
+        unsigned long wmPid = pid;
+        XChangeProperty(display_, client.wid, netWmPid_, XA_CARDINAL, 32, PropModeReplace, reinterpret_cast<unsigned char*>(&wmPid), 1);
+        XMapWindow(display_, client.wid);
+        clients_.push_back(client);
+        
+        std::vector<unsigned long> list;
+        for(const auto& client : clients_) list.push_back(client.wid);
+        XChangeProperty(display_, DefaultRootWindow(display_), netClientList_, XA_WINDOW, 32, PropModeReplace, 
+                        reinterpret_cast<unsigned char*>(list.data()), list.size());
+        XFlush(display_);
+    }
+    
+    void setDaemon(pid_t pid)
+    {
+        daemon_ = pid;
+    }
+    
+    void activate(size_t index)
+    {
+        unsigned long wid = clients_[index].wid;
+        XChangeProperty(display_, DefaultRootWindow(display_), netActiveWindow_, XA_WINDOW, 32, PropModeReplace, 
+                        reinterpret_cast<unsigned char*>(&wid), 1);
+        XFlush(display_);
+    }
+    
+    //waits for stop and continue notifications of the clients, returns false if the daemon died
+    bool waitEvents(int timeoutMs)
+    {
+        pollfd pollFd = {sigFd_, POLLIN, 0};
+        if(poll(&pollFd, 1, timeoutMs) <= 0) return true;
+        signalfd_siginfo sigInfo;
+        while(read(sigFd_, &sigInfo, sizeof(sigInfo)) == sizeof(sigInfo));
+        uint64_t eventTime = now();
+        
+        siginfo_t info;
+        while(true)
+        {
+            info.si_pid = 0;
+            if(waitid(P_ALL, 0, &info, WSTOPPED | WCONTINUED | WEXITED | WNOHANG) < 0 || info.si_pid == 0) break;
+            if(info.si_pid == daemon_ && (info.si_code == CLD_EXITED || info.si_code == CLD_KILLED || info.si_code == CLD_DUMPED))
+            {
+                std::cerr<<"sigstoped exited unexpectedly\n";
+                return false;
+            }
+            for(auto& client : clients_)
+            {
+                if(client.pid != info.si_pid) continue;
+                if(info.si_code == CLD_STOPPED) client.stopped = true;
+                else if(info.si_code == CLD_CONTINUED) client.stopped = false;
+                client.eventTime = eventTime;
+            }
+        }
+        return true;
+    }
+    
+    //sigstoped may not be listening yet, so focus is toggled until it stops the first client
+    bool waitReady()
+    {
+        for(int waited = 0; waited < STARTUP_TIMEOUT_MS; waited += 200)
+        {
+            activate(0);
+            if(!waitEvents(100)) return false;
+            activate(1);
+            if(!waitEvents(100)) return false;
+            if(clients_[0].stopped) break;
+        }
+        if(!clients_[0].stopped) return false;
+        
+        //let late events from the toggling arrive before the measurement starts
+        for(int i = 0; i < 5; ++i) if(!waitEvents(100)) return false;
+        return true;
+    }
+    
+    bool focus(size_t current, size_t next, bool record)
+    {
+        Client& from = clients_[current];
+        Client& to = clients_[next];
+        bool needsResume = to.stopped;
+        from.eventTime = 0;
+        to.eventTime = 0;
+        
+        uint64_t startTime = now();
+        activate(next);
+        while(from.stopped == false || to.stopped == true)
+        {
+            if(now() - startTime > SWITCH_TIMEOUT_MS*1000ULL)
+            {
+                std::cerr<<"Switch from pid "<<from.pid<<" to "<<to.pid<<" timed out\n";
+                return false;
+            }
+            if(!waitEvents(SWITCH_TIMEOUT_MS)) return false;
+        }
+        if(!record) return true;
+        if(needsResume) resumeLatency.push_back(to.eventTime - startTime);
+        stopLatency.push_back(from.eventTime - startTime);
+        return true;
+    }
+    
+    size_t clientCount()
+    {
+        return clients_.size();
+    }
+};
+
+static std::string summary(std::vector<uint64_t> samples)
+{
+    if(samples.empty()) return "no samples";
+    std::sort(samples.begin(), samples.end());
+    size_t p99 = std::min(samples.size()-1, samples.size()*99/100);
+    return "p50: " + std::to_string(samples[samples.size()/2]) + " p99: " + std::to_string(samples[p99]) + 
+           " max: " + std::to_string(samples.back()) + " samples: " + std::to_string(samples.size());
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig config;
+    argp_parse(&argp, argc, argv, 0, 0, &config);
+    
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    int sigFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    
+    char home[] = "/tmp/focusbenchXXXXXX";
+    if(mkdtemp(home) == nullptr)
+    {
+        std::cerr<<"Can not create a home directory for sigstoped: "<<strerror(errno)<<'\n';
+        return 1;
+    }
+    const std::string confDir = std::string(home) + "/.config/sigstoped/";
+    mkdir((std::string(home) + "/.config").c_str(), 0755);
+    mkdir(confDir.c_str(), 0755);
+    std::fstream(confDir + "blacklist", std::fstream::out)<<CLIENT_NAME<<" timeout=0 children=yes\n";
+    
+    pid_t xvfb = spawn({XVFB_PATH, config.display, "-nolisten", "tcp", nullptr}, std::string(), config.display, "/dev/null");
+    Bench bench(sigFd);
+    int ret = 1;
+    pid_t daemon = -1;
+    std::vector<pid_t> clients;
+    
+    if(!bench.connect(config.display))
+    {
+        std::cerr<<"Can not connect to Xvfb on "<<config.display<<'\n';
+    }
+    else
+    {
+        for(int i = 0; i < config.clients; ++i) 
+        {
+            clients.push_back(spawnClient(config.treeSize));
+            bench.addClient(clients.back());
+        }
+        
+        daemon = spawn({config.daemon, "-t", "0", nullptr}, home, config.display, config.log);
+        bench.setDaemon(daemon);
+        std::cout<<"Started Xvfb on "<<config.display<<", sigstoped and "<<config.clients<<" clients with "
+            <<config.treeSize<<" children each\n";
+        
+        if(!bench.waitReady())
+        {
+            std::cerr<<"sigstoped did not react to focus changes\n";
+        }
+        else
+        {
+            //bring every client into the state it has in the measurement: stopped unless focused
+            size_t current = 1;
+            bool ok = true;
+            for(size_t i = 0; ok && i < bench.clientCount(); ++i)
+            {
+                size_t next = (current+1)%bench.clientCount();
+                ok = bench.focus(current, next, false);
+                current = next;
+            }
+            
+            std::minstd_rand random(1);
+            for(int i = 0; ok && i < config.switches; ++i)
+            {
+                size_t next = (current + 1 + random()%(bench.clientCount()-1))%bench.clientCount();
+                ok = bench.focus(current, next, true);
+                current = next;
+            }
+            
+            if(ok)
+            {
+                std::cout<<"Resume latency [us] "<<summary(bench.resumeLatency)<<'\n';
+                std::cout<<"Stop latency [us] "<<summary(bench.stopLatency)<<'\n';
+                ret = 0;
+            }
+        }
+    }
+    
+    //sigstoped resumes everything it stopped on exit
+    if(daemon > 0)
+    {
+        kill(daemon, SIGTERM);
+        waitpid(daemon, nullptr, 0);
+    }
+    for(const auto& pid : clients) kill(pid, SIGKILL);
+    for(const auto& pid : clients) waitpid(pid, nullptr, 0);
+    bench.disconnect();
+    kill(xvfb, SIGTERM);
+    waitpid(xvfb, nullptr, 0);
+    std::error_code error;
+    std::filesystem::remove_all(home, error);
+    return ret;
+}
@@ -0,0 +1,227 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <argp.h>
+#include "fakeproctree.h"
+#include "process.h"
+#include "metrics.h"
+#include "split.h"
+
+struct BenchConfig
+{
+    std::vector<size_t> sizes = {10000, 50000, 100000};
+    int repetitions = 5;
+    double tolerancePercent = 25;
+    const char* baseline = nullptr;
+    const char* output = nullptr;
+};
+
+static char doc[] = "Times the proc layer of sigstoped against synthetic proc trees, signals are counted instead of sent.";
+static char args_doc[] = "";
+
+static struct argp_option options[] = 
+{
+  {"sizes", 's', "pids",      0,  "Comma separated tree sizes, defaults to 10000,50000,100000" },
+  {"repetitions", 'n', "count",      0,  "How often every operation is timed, the median is reported, defaults to 5" },
+  {"output", 'o', "file",      0,  "Also write the results to this file, it can be used as a baseline later" },
+  {"baseline", 'b', "file",      0,  "Fail if an operation is slower than in this result file" },
+  {"tolerance", 't', "percent",      0,  "How much slower than the baseline an operation may be, defaults to 25" },
+  { 0 }
+};
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+    BenchConfig* config = reinterpret_cast<BenchConfig*>(state->input);
+    switch (key)
+    {
+        case 's':
+        config->sizes.clear();
+        for(const auto& size : split(arg, ','))
+        {
+            long count = atol(size.c_str());
+            if(count < 2) argp_error(state, "trees need at least 2 pids");
+            config->sizes.push_back(count);
+        }
+        break;
+        case 'n':
+        config->repetitions = atol(arg);
+        if(config->repetitions < 1) argp_error(state, "repetitions must be at least 1");
+        break;
+        case 'o':
+        config->output = arg;
+        break;
+        case 'b':
+        config->baseline = arg;
+        break;
+        case 't':
+        config->tolerancePercent = atof(arg);
+        break;
+        default:
+        return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+//regressions smaller than this are timer and cache noise
+static constexpr uint64_t NOISE_FLOOR_US = 200;
+
+static size_t signalCount = 0;
+
+static int countSignal(pid_t pid, int sig)
+{
+    (void)pid;
+    (void)sig;
+    ++signalCount;
+    return 0;
+}
+
+static uint64_t median(std::vector<uint64_t> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size()/2];
+}
+
+static uint64_t timeOperation(int repetitions, const std::function<void()>& operation)
+{
+    std::vector<uint64_t> samples;
+    for(int i = 0; i < repetitions; ++i)
+    {
+        uint64_t startTime = Metrics::now();
+        operation();
+        samples.push_back(Metrics::now() - startTime);
+    }
+    return median(samples);
+}
+
+static std::unordered_map<std::string, uint64_t> loadResults(const char* fileName)
+{
+    std::unordered_map<std::string, uint64_t> results;
+    std::fstream file(fileName, std::fstream::in);
+    std::string name;
+    uint64_t us;
+    while(file>>name>>us) results[name] = us;
+    return results;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig config;
+    argp_parse(&argp, argc, argv, 0, 0, &config);
+    
+    Process::signalSink = countSignal;
+    std::vector<std::pair<std::string, uint64_t>> results;
+    bool ok = true;
+    
+    auto report = [&results](const std::string& name, uint64_t us)
+    {
+        std::cout<<name<<' '<<us<<" us\n";
+        results.push_back({name, us});
+    };
+    
+    for(const auto& size : config.sizes)
+    {
+        std::string lines;
+        for(size_t i = 0; i < size; ++i) lines += std::to_string(i) + '\n';
+        report("split_" + std::to_string(size), timeOperation(config.repetitions, [&lines](){ split(lines); }));
+        
+        for(auto shape : {FakeProcTree::SHAPE_WIDE, FakeProcTree::SHAPE_DEEP})
+        {
+            const std::string suffix = std::string("_") + FakeProcTree::shapeName(shape) + '_' + std::to_string(size);
+            FakeProcTree tree;
+            uint64_t startTime = Metrics::now();
+            if(!tree.create(size, shape)) return 1;
+            std::cout<<"generated "<<size<<" pids in "<<tree.getRoot()<<" in "<<(Metrics::now() - startTime)/1000<<" ms\n";
+            if(!Process::setProcRoot(tree.getRoot()))
+            {
+                std::cerr<<"Can not use "<<tree.getRoot()<<" as proc root\n";
+                return 1;
+            }
+            
+            //every pid but init descends from the application
+            const size_t expected = size - 2;
+            size_t found = 0;
+            report("getChildren" + suffix, timeOperation(config.repetitions, [&found]()
+                { found = Process(FakeProcTree::APP_PID).getChildren().size(); }));
+            if(found != (shape == FakeProcTree::SHAPE_WIDE ? expected : std::min<size_t>(expected, 1))) ok = false;
+            
+            report("getDescendants" + suffix, timeOperation(config.repetitions, [&found]()
+                { found = Process(FakeProcTree::APP_PID).getDescendants().size(); }));
+            if(found != expected) ok = false;
+            
+            report("byName" + suffix, timeOperation(config.repetitions, [&found]()
+                { found = Process::byName(FakeProcTree::APP_NAME).size(); }));
+            if(found != 1) ok = false;
+            
+            signalCount = 0;
+            report("stopResume" + suffix, timeOperation(config.repetitions, []()
+                {
+                    Process process(FakeProcTree::APP_PID);
+                    process.stop(true);
+                    process.resume(true);
+                }));
+            if(signalCount != 2*(expected+1)*config.repetitions) ok = false;
+            
+            if(!ok)
+            {
+                std::cerr<<"Wrong result for "<<Process::getProcRoot()<<", the fake tree is not read correctly\n";
+                return 1;
+            }
+        }
+    }
+    
+    if(config.output)
+    {
+        std::fstream file(config.output, std::fstream::out | std::fstream::trunc);
+        for(const auto& result : results) file<<result.first<<' '<<result.second<<'\n';
+        if(!file.good()) std::cerr<<"Can not write "<<config.output<<'\n';
+    }
+    
+    if(config.baseline)
+    {
+        std::unordered_map<std::string, uint64_t> baseline = loadResults(config.baseline);
+        if(baseline.empty())
+        {
+            std::cerr<<"Can not read baseline "<<config.baseline<<'\n';
+            return 1;
+        }
+        for(const auto& result : results)
+        {
+            auto entry = baseline.find(result.first);
+            if(entry == baseline.end()) continue;
+            uint64_t limit = entry->second*(1 + config.tolerancePercent/100);
+            if(result.second > limit && result.second - entry->second > NOISE_FLOOR_US)
+            {
+                std::cerr<<result.first<<" regressed from "<<entry->second<<" us to "<<result.second<<" us\n";
+                ok = false;
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "blacklist.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+#include <cctype>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include "debug.h"
+
+template<size_t N> static bool hasPrefix(const std::string& string, const char (&prefix)[N])
+{
+    return string.compare(0, N-1, prefix) == 0;
+}
+
+void Blacklist::clear()
+{
+    rules_.clear();
+    names_.clear();
+    globs_.clear();
+    regexes_.clear();
+    exes_.clear();
+    cmdlines_.clear();
+}
+
+void Blacklist::load(const std::vector<std::string>& lines)
+{
+    clear();
+    rules_.reserve(lines.size());
+    for(const auto& line : lines) addRule(line);
+}
+
+bool Blacklist::parseOption(const std::string& option, Rule& rule)
+{
+    size_t separator = option.find('=');
+    if(separator == std::string::npos) return false;
+    const std::string key = option.substr(0, separator);
+    const std::string value = option.substr(separator+1);
+    if(key == "signal")
+    {
+        if(value == "tree") rule.signalMode = Process::SIGNAL_TREE;
+        else if(value == "group") rule.signalMode = Process::SIGNAL_GROUP;
+        else if(value == "session") rule.signalMode = Process::SIGNAL_SESSION;
+        else std::cerr<<"Unknown signal mode \""<<value<<"\" in blacklist, use tree, group or session\n";
+    }
+    else if(key == "timeout")
+    {
+        char* end;
+        long timeout = strtol(value.c_str(), &end, 10);
+        if(value.empty() || *end != '\0' || timeout < 0 || timeout > INT_MAX) 
+            std::cerr<<"Invalid timeout \""<<value<<"\" in blacklist, use a number of seconds\n";
+        else rule.timeoutSecs = timeout;
+    }
+    else if(key == "children")
+    {
+        if(value == "yes") rule.children = true;
+        else if(value == "no") rule.children = false;
+        else std::cerr<<"Unknown children value \""<<value<<"\" in blacklist, use yes or no\n";
+    }
+    else if(!key.empty() && std::all_of(key.begin(), key.end(), [](unsigned char ch){return islower(ch);}))
+    {
+        //a mistyped option must not become part of the pattern, the rule would never match
+        std::cerr<<"Unknown option \""<<key<<"\" in blacklist, use signal, timeout or children\n";
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void Blacklist::addRule(const std::string& rawLine)
+{
+    size_t start = rawLine.find_first_not_of(" \t");
+    if(start == std::string::npos || rawLine[start] == '#') return;
+    
+    size_t index = rules_.size();
+    Rule rule;
+    rule.pattern = rawLine.substr(start);
+    
+    //options are trailing key=value tokens, everything before them is the pattern
+    std::string line = rule.pattern;
+    while(true)
+    {
+        size_t end = line.find_last_not_of(" \t");
+        line.resize(end == std::string::npos ? 0 : end+1);
+        size_t separator = line.find_last_of(" \t");
+        if(separator == std::string::npos || !parseOption(line.substr(separator+1), rule)) break;
+        line.resize(separator);
+    }
+    if(line.empty()) return;
+    
+    if(hasPrefix(line, REGEX_PREFIX))
+    {
+        try
+        {
+            regexes_.push_back({std::regex(line.substr(sizeof(REGEX_PREFIX)-1), std::regex::extended | std::regex::nosubs), index});
+        }
+        catch(const std::regex_error& error)
+        {
+            std::cerr<<"Invalid regex in blacklist rule \""<<line<<"\": "<<error.what()<<'\n';
+            return;
+        }
+    }
+    else if(hasPrefix(line, EXE_PREFIX))
+    {
+        struct stat exeStat;
+        std::string path = line.substr(sizeof(EXE_PREFIX)-1);
+        if(stat(path.c_str(), &exeStat) != 0)
+        {
+            std::cerr<<"Can not stat "<<path<<" for blacklist rule \""<<line<<"\"\n";
+            return;
+        }
+        exes_[{exeStat.st_dev, exeStat.st_ino}] = index;
+    }
+    else if(hasPrefix(line, CMDLINE_PREFIX))
+    {
+        cmdlines_.push_back({line.substr(sizeof(CMDLINE_PREFIX)-1), index});
+    }
+    else if(line.find_first_of("*?[") != std::string::npos)
+    {
+        globs_.push_back({line, index});
+    }
+    else
+    {
+        names_.insert({line, index});
+    }
+    rules_.push_back(rule);
+}
+
+const Rule* Blacklist::match(Process& process) const
+{
+    if(process.getPid() <= 0) return nullptr;
+    const std::string name = process.getName();
+    if(name.empty()) return nullptr;
+    
+    auto search = names_.find(name);
+    if(search != names_.end()) return &rules_[search->second];
+    
+    for(const auto& glob : globs_)
+    {
+        if(fnmatch(glob.first.c_str(), name.c_str(), 0) == 0) return &rules_[glob.second];
+    }
+    
+    for(const auto& regex : regexes_)
+    {
+        if(std::regex_match(name, regex.first)) return &rules_[regex.second];
+    }
+    
+    if(!exes_.empty())
+    {
+        dev_t dev;
+        ino_t ino;
+        if(process.getExeId(dev, ino))
+        {
+            auto exe = exes_.find({dev, ino});
+            if(exe != exes_.end()) return &rules_[exe->second];
+        }
+    }
+    
+    if(!cmdlines_.empty())
+    {
+        const std::string cmdline = process.getCmdline();
+        for(const auto& glob : cmdlines_)
+        {
+            if(fnmatch(glob.first.c_str(), cmdline.c_str(), 0) == 0) return &rules_[glob.second];
+        }
+    }
+    
+    return nullptr;
+}
+
+size_t Blacklist::size() const
+{
+    return rules_.size();
+}
+
+bool Blacklist::empty() const
+{
+    return rules_.empty();
+}
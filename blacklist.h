@@ -0,0 +1,71 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <regex>
+#include <unordered_map>
+#include <sys/types.h>
+#include "process.h"
+
+struct Rule
+{
+    std::string pattern;
+    Process::SignalMode signalMode = Process::SIGNAL_TREE;
+    int timeoutSecs = -1; //-1 uses the global timeout
+    bool children = true;
+};
+
+class Blacklist
+{
+private:
+    struct FileId
+    {
+        dev_t dev;
+        ino_t ino;
+        bool operator==(const FileId& in) const {return dev == in.dev && ino == in.ino;}
+    };
+    
+    struct FileIdHash
+    {
+        size_t operator()(const FileId& id) const {return std::hash<dev_t>()(id.dev) ^ (std::hash<ino_t>()(id.ino) << 1);}
+    };
+    
+    std::vector<Rule> rules_;
+    std::unordered_map<std::string, size_t> names_;
+    std::vector<std::pair<std::string, size_t>> globs_;
+    std::vector<std::pair<std::regex, size_t>> regexes_;
+    std::unordered_map<FileId, size_t, FileIdHash> exes_;
+    std::vector<std::pair<std::string, size_t>> cmdlines_;
+    
+    void addRule(const std::string& rawLine);
+    static bool parseOption(const std::string& option, Rule& rule);
+    
+public:
+    static constexpr char REGEX_PREFIX[] = "regex:";
+    static constexpr char EXE_PREFIX[] = "exe:";
+    static constexpr char CMDLINE_PREFIX[] = "cmdline:";
+    
+    void load(const std::vector<std::string>& lines);
+    void clear();
+    const Rule* match(Process& process) const;
+    size_t size() const;
+    bool empty() const;
+};
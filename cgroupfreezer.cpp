@@ -0,0 +1,327 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "cgroupfreezer.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include "process.h"
+#include "metrics.h"
+#include "split.h"
+#include "debug.h"
+
+std::string CgroupFreezer::findMount()
+{
+    std::fstream mountinfo("/proc/self/mountinfo", std::fstream::in);
+    std::string line;
+    while(std::getline(mountinfo, line))
+    {
+        //the filesystem type follows the " - " separator, the mount point is the fifth field
+        size_t separator = line.find(" - ");
+        if(separator == std::string::npos || line.compare(separator+3, 8, "cgroup2 ") != 0) continue;
+        std::vector<std::string> tokens = split(line, ' ');
+        if(tokens.size() > 4) return tokens[4];
+    }
+    return std::string();
+}
+
+std::string CgroupFreezer::ownCgroup()
+{
+    std::fstream cgroupFile("/proc/self/cgroup", std::fstream::in);
+    std::string line;
+    while(std::getline(cgroupFile, line))
+    {
+        if(line.compare(0, 3, "0::") == 0) return line.substr(3);
+    }
+    return std::string();
+}
+
+bool CgroupFreezer::writeFile(const std::string& fileName, const std::string& value)
+{
+    std::fstream file(fileName, std::fstream::out);
+    if(!file.is_open()) return false;
+    file<<value;
+    file.close();
+    return !file.fail();
+}
+
+long long CgroupFreezer::readValue(const std::string& fileName)
+{
+    std::fstream file(fileName, std::fstream::in);
+    long long value = -1;
+    if(!(file>>value)) return -1;
+    return value;
+}
+
+bool CgroupFreezer::open(const std::string& base)
+{
+    mount_ = findMount();
+    if(base.empty())
+    {
+        if(mount_.empty())
+        {
+            std::cerr<<"No cgroup v2 hierarchy is mounted\n";
+            return false;
+        }
+        //leafs are created next to the cgroup of sigstoped, so that the common ancestor
+        //of the applications and the leafs is one the user is likely to be delegated
+        std::filesystem::path own = std::filesystem::path(mount_ + ownCgroup()).lexically_normal();
+        base_ = (own.parent_path() / "sigstoped").string();
+    }
+    else
+    {
+        base_ = base;
+    }
+    
+    std::error_code error;
+    std::filesystem::create_directory(base_, error);
+    if(error || !std::filesystem::exists(base_ + "/cgroup.freeze"))
+    {
+        std::cerr<<"Can not create freezer cgroup "<<base_<<'\n';
+        return false;
+    }
+    //the cpu controller is only needed for demotion and the memory controller for reclaim,
+    //so failing to enable them is not an error, they are enabled one by one as a write that
+    //names an unavailable controller enables none
+    writeFile(base_ + "/cgroup.subtree_control", "+cpu");
+    writeFile(base_ + "/cgroup.subtree_control", "+memory");
+    
+    //leafs left behind by an earlier instance are thawed and removed once empty, the journal
+    //replay freezes whatever should stay frozen again
+    for(const auto& entry : std::filesystem::directory_iterator(base_, error))
+    {
+        if(entry.is_directory(error)) leafs_.insert(entry.path().string());
+    }
+    thawAll();
+    prune();
+    return true;
+}
+
+CgroupFreezer::Leaf* CgroupFreezer::container(Process& process)
+{
+    if(mount_.empty()) return nullptr;
+    std::vector<std::string> lines = split(process.readFile("cgroup"));
+    for(const auto& line : lines)
+    {
+        if(line.compare(0, 3, "0::") != 0) continue;
+        std::string path = std::filesystem::path(mount_ + line.substr(3)).lexically_normal().string();
+        for(auto& adopted : adopted_)
+        {
+            if(adopted.second.path == path) return &adopted.second;
+        }
+    }
+    return nullptr;
+}
+
+CgroupFreezer::Leaf* CgroupFreezer::find(Process& process)
+{
+    //a recycled pid is a different process that has not been adopted
+    auto adopted = adopted_.find(process.getPid());
+    if(adopted == adopted_.end() || adopted->second.starttime != process.getStartTime()) return nullptr;
+    return &adopted->second;
+}
+
+CgroupFreezer::Leaf* CgroupFreezer::adopt(Process& process)
+{
+    if(base_.empty() || process.getPid() <= 0) return nullptr;
+    if(Leaf* leaf = find(process)) return leaf;
+    prune();
+    
+    //every application instance gets its own leaf, instances sharing a name must not freeze each other
+    std::string name = process.getName();
+    for(auto& ch : name) if(ch == '/' || ch == '.') ch = '_';
+    std::string path = base_ + "/" + name + "_" + std::to_string(process.getPid());
+    std::error_code error;
+    std::filesystem::create_directory(path, error);
+    if(error) return nullptr;
+    leafs_.insert(path);
+    
+    if(!writeFile(path + "/cgroup.procs", std::to_string(process.getPid())))
+    {
+        std::cerr<<"Can not move pid "<<process.getPid()<<" into "<<path<<": "<<strerror(errno)<<'\n';
+        return nullptr;
+    }
+    //processes forked from here on are created in the leaf, existing children have to be moved
+    std::vector<pid_t> descendants = process.getDescendants();
+    for(const auto& pid : descendants) writeFile(path + "/cgroup.procs", std::to_string(pid));
+    Leaf& leaf = adopted_[process.getPid()];
+    leaf.starttime = process.getStartTime();
+    leaf.path = path;
+    leaf.frozen = false;
+    return &leaf;
+}
+
+bool CgroupFreezer::waitFrozen(const std::string& leaf, int timeoutMs)
+{
+    int fd = ::open((leaf + "/cgroup.events").c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+    
+    auto readFrozen = [fd]()
+    {
+        char buffer[256];
+        ssize_t length = pread(fd, buffer, sizeof(buffer)-1, 0);
+        if(length <= 0) return false;
+        buffer[length] = '\0';
+        return strstr(buffer, "frozen 1") != nullptr;
+    };
+    
+    //cgroup.events signals POLLPRI whenever its content changes
+    uint64_t deadline = Metrics::now() + timeoutMs*1000;
+    bool frozen = readFrozen();
+    while(!frozen)
+    {
+        uint64_t now = Metrics::now();
+        if(now >= deadline) break;
+        pollfd event = {fd, POLLPRI, 0};
+        if(poll(&event, 1, (deadline - now + 999)/1000) < 0 && errno != EINTR) break;
+        frozen = readFrozen();
+    }
+    ::close(fd);
+    return frozen;
+}
+
+bool CgroupFreezer::freeze(Process& process)
+{
+    Leaf* leaf = adopt(process);
+    if(!leaf || !writeFile(leaf->path + "/cgroup.freeze", "1")) return false;
+    
+    //tasks in uninterruptible sleep delay the freeze, rather than report a stop that
+    //has not happened the freeze is abandoned and the caller falls back to signals
+    if(!waitFrozen(leaf->path, FREEZE_TIMEOUT_MS))
+    {
+        std::cerr<<"Freezing "<<leaf->path<<" did not finish within "<<FREEZE_TIMEOUT_MS<<"ms\n";
+        writeFile(leaf->path + "/cgroup.freeze", "0");
+        return false;
+    }
+    leaf->frozen = true;
+    return true;
+}
+
+bool CgroupFreezer::thaw(Process& process)
+{
+    //leafs are also adopted for demotion and may hold a process stoped with SIGSTOP,
+    //only a leaf frozen here can be resumed by thawing it
+    Leaf* leaf = find(process);
+    if(!leaf)
+    {
+        //an application started from an adopted one was moved into its leaf and frozen with it,
+        //moving it into a leaf of its own thaws it without thawing its ancestor
+        Leaf* ancestor = container(process);
+        return ancestor && ancestor->frozen && adopt(process);
+    }
+    if(!leaf->frozen) return false;
+    if(!writeFile(leaf->path + "/cgroup.freeze", "0")) return false;
+    leaf->frozen = false;
+    return true;
+}
+
+long long CgroupFreezer::reclaim(Process& process)
+{
+    const Leaf* leaf = find(process);
+    if(!leaf) return -1;
+    long long before = readValue(leaf->path + "/memory.current");
+    if(before < 0) return -1;
+    
+    //the write fails with EAGAIN when less than requested could be reclaimed, what was freed stays freed
+    if(!writeFile(leaf->path + "/memory.reclaim", std::to_string(before)) && errno != EAGAIN) return -1;
+    long long after = readValue(leaf->path + "/memory.current");
+    return after >= 0 && after < before ? before - after : 0;
+}
+
+bool CgroupFreezer::reclaimAvailable()
+{
+    //leafs get memory.reclaim if the memory controller is enabled for them and the kernel has it,
+    //which the base cgroup shows before any leaf exists
+    if(base_.empty() || !std::filesystem::exists(base_ + "/memory.reclaim")) return false;
+    std::fstream controlFile(base_ + "/cgroup.subtree_control", std::fstream::in);
+    std::string controller;
+    while(controlFile>>controller)
+    {
+        if(controller == "memory") return true;
+    }
+    return false;
+}
+
+bool CgroupFreezer::setIdle(Process& process, bool idle)
+{
+    const Leaf* leaf = idle ? adopt(process) : find(process);
+    if(!leaf || !std::filesystem::exists(leaf->path + "/cpu.idle")) return false;
+    return writeFile(leaf->path + "/cpu.idle", idle ? "1" : "0");
+}
+
+bool CgroupFreezer::throttle(Process& process, int percent)
+{
+    const Leaf* leaf = percent > 0 ? adopt(process) : find(process);
+    if(!leaf) return false;
+    if(percent <= 0) return writeFile(leaf->path + "/cpu.max", "max " + std::to_string(CPU_PERIOD_US));
+    if(!std::filesystem::exists(leaf->path + "/cpu.max")) return false;
+    return writeFile(leaf->path + "/cpu.max", std::to_string(CPU_PERIOD_US*percent/100) + " " + std::to_string(CPU_PERIOD_US));
+}
+
+void CgroupFreezer::release(Process& process)
+{
+    auto adopted = adopted_.find(process.getPid());
+    if(adopted == adopted_.end()) return;
+    //an exited process has no stat file left, a start time cached before it exited is still checked
+    unsigned long long starttime = process.getStartTime();
+    if(starttime != 0 && adopted->second.starttime != starttime) return;
+    //the leaf can only be removed once the last descendant has left it too
+    writeFile(adopted->second.path + "/cgroup.freeze", "0");
+    if(rmdir(adopted->second.path.c_str()) == 0) leafs_.erase(adopted->second.path);
+    adopted_.erase(adopted);
+}
+
+void CgroupFreezer::prune()
+{
+    //removing a leaf fails as long as any process is left in it
+    for(auto leaf = leafs_.begin(); leaf != leafs_.end();)
+    {
+        if(rmdir(leaf->c_str()) < 0)
+        {
+            ++leaf;
+            continue;
+        }
+        for(auto adopted = adopted_.begin(); adopted != adopted_.end();)
+        {
+            if(adopted->second.path == *leaf) adopted = adopted_.erase(adopted);
+            else ++adopted;
+        }
+        leaf = leafs_.erase(leaf);
+    }
+}
+
+void CgroupFreezer::thawAll()
+{
+    for(auto& adopted : adopted_) adopted.second.frozen = false;
+    for(const auto& leaf : leafs_) 
+    {
+        writeFile(leaf + "/cgroup.freeze", "0");
+        writeFile(leaf + "/cpu.idle", "0");
+        writeFile(leaf + "/cpu.max", "max " + std::to_string(CPU_PERIOD_US));
+    }
+}
+
+std::string CgroupFreezer::getBase()
+{
+    return base_;
+}
@@ -0,0 +1,67 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <string>
+#include <unordered_set>
+#include <unordered_map>
+#include <sys/types.h>
+
+class Process;
+
+class CgroupFreezer
+{
+private:
+    static constexpr long CPU_PERIOD_US = 100000;
+    static constexpr int FREEZE_TIMEOUT_MS = 100;
+    
+    struct Leaf
+    {
+        unsigned long long starttime;
+        std::string path;
+        bool frozen = false;
+    };
+    
+    std::string mount_;
+    std::string base_;
+    std::unordered_set<std::string> leafs_;
+    std::unordered_map<pid_t, Leaf> adopted_;
+    
+    Leaf* find(Process& process);
+    Leaf* adopt(Process& process);
+    Leaf* container(Process& process);
+    static bool waitFrozen(const std::string& leaf, int timeoutMs);
+    static bool writeFile(const std::string& fileName, const std::string& value);
+    static long long readValue(const std::string& fileName);
+    static std::string findMount();
+    static std::string ownCgroup();
+    
+public:
+    bool open(const std::string& base = std::string());
+    bool freeze(Process& process);
+    bool thaw(Process& process);
+    long long reclaim(Process& process);
+    bool reclaimAvailable();
+    bool setIdle(Process& process, bool idle);
+    bool throttle(Process& process, int percent);
+    void release(Process& process);
+    void thawAll();
+    void prune();
+    std::string getBase();
+};
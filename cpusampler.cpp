@@ -0,0 +1,114 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "cpusampler.h"
+#include <string>
+#include <cstdlib>
+#include <unistd.h>
+#include "process.h"
+#include "metrics.h"
+
+bool CpuSampler::readSwitches(pid_t pid, unsigned long long& switches)
+{
+    std::string status = Process(pid).readFile("status");
+    if(status.empty()) return false;
+    
+    //voluntary_ctxt_switches is matched as the tail of nonvoluntary_ctxt_switches too
+    switches = 0;
+    size_t position = 0;
+    while((position = status.find("voluntary_ctxt_switches:", position)) != std::string::npos)
+    {
+        position += sizeof("voluntary_ctxt_switches:")-1;
+        switches += strtoull(status.c_str() + position, nullptr, 10);
+    }
+    return true;
+}
+
+void CpuSampler::start(Process& process, bool children, bool switches)
+{
+    //the tree is walked once here, later samples only read the files of every member
+    switches_ = switches;
+    time_ = 0;
+    members_.clear();
+    members_.push_back({process.getPid(), 0, 0});
+    if(children)
+    {
+        std::vector<pid_t> descendants = process.getDescendants();
+        for(const auto& pid : descendants) members_.push_back({pid, 0, 0});
+    }
+    sample();
+}
+
+double CpuSampler::sample()
+{
+    uint64_t now = Metrics::now();
+    unsigned long long elapsedTicks = 0;
+    unsigned long long elapsedSwitches = 0;
+    for(auto member = members_.begin(); member != members_.end();)
+    {
+        ProcStat stat;
+        unsigned long long switches = 0;
+        if(!Process::readStat(member->pid, stat) || (switches_ && !readSwitches(member->pid, switches)))
+        {
+            member = members_.erase(member);
+            continue;
+        }
+        unsigned long long ticks = stat.utime + stat.stime;
+        if(ticks >= member->ticks) elapsedTicks += ticks - member->ticks;
+        if(switches >= member->switches) elapsedSwitches += switches - member->switches;
+        member->ticks = ticks;
+        member->switches = switches;
+        ++member;
+    }
+    
+    //the first sample only establishes the baseline
+    static const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    bool baseline = time_ == 0 || now <= time_;
+    lastSeconds_ = baseline ? 0 : (now - time_)/1000000.0;
+    lastCpuSeconds_ = baseline ? 0 : elapsedTicks/static_cast<double>(ticksPerSecond);
+    lastSwitches_ = baseline ? 0 : elapsedSwitches;
+    time_ = now;
+    return lastSeconds_ > 0 ? lastCpuSeconds_*100/lastSeconds_ : 0;
+}
+
+void CpuSampler::clear()
+{
+    members_.clear();
+    time_ = 0;
+}
+
+bool CpuSampler::empty()
+{
+    return members_.empty();
+}
+
+double CpuSampler::getLastSeconds()
+{
+    return lastSeconds_;
+}
+
+double CpuSampler::getLastCpuSeconds()
+{
+    return lastCpuSeconds_;
+}
+
+unsigned long long CpuSampler::getLastSwitches()
+{
+    return lastSwitches_;
+}
@@ -0,0 +1,54 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <sys/types.h>
+
+class Process;
+
+class CpuSampler
+{
+private:
+    struct Member
+    {
+        pid_t pid;
+        unsigned long long ticks;
+        unsigned long long switches;
+    };
+    
+    std::vector<Member> members_;
+    bool switches_ = false;
+    uint64_t time_ = 0;
+    double lastSeconds_ = 0;
+    double lastCpuSeconds_ = 0;
+    unsigned long long lastSwitches_ = 0;
+    
+    static bool readSwitches(pid_t pid, unsigned long long& switches);
+    
+public:
+    void start(Process& process, bool children, bool switches = false);
+    double sample();
+    void clear();
+    bool empty();
+    double getLastSeconds();
+    double getLastCpuSeconds();
+    unsigned long long getLastSwitches();
+};
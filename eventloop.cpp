@@ -0,0 +1,96 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "eventloop.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <unistd.h>
+
+EventLoop::EventLoop()
+{
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    if(epollFd_ < 0) std::cerr<<"Can not create epoll instance: "<<strerror(errno)<<'\n';
+    else running_ = true;
+}
+
+bool EventLoop::isOpen()
+{
+    return epollFd_ >= 0;
+}
+
+bool EventLoop::add(int fd, std::function<void(uint32_t)> callback, uint32_t events)
+{
+    if(fd < 0 || epollFd_ < 0) return false;
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+    if(epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) < 0) return false;
+    callbacks_[fd] = callback;
+    return true;
+}
+
+void EventLoop::remove(int fd)
+{
+    auto search = callbacks_.find(fd);
+    if(search == callbacks_.end()) return;
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    callbacks_.erase(search);
+}
+
+bool EventLoop::contains(int fd)
+{
+    return callbacks_.find(fd) != callbacks_.end();
+}
+
+void EventLoop::wait(int timeoutMs)
+{
+    epoll_event events[MAX_EVENTS];
+    int count = epoll_wait(epollFd_, events, MAX_EVENTS, timeoutMs);
+    if(count < 0)
+    {
+        if(errno != EINTR) std::cerr<<"epoll_wait failed: "<<strerror(errno)<<'\n';
+        return;
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        //a callback may remove other fds from the loop, so look every one up again
+        auto search = callbacks_.find(events[i].data.fd);
+        if(search == callbacks_.end()) continue;
+        std::function<void(uint32_t)> callback = search->second;
+        callback(events[i].events);
+    }
+}
+
+void EventLoop::stop()
+{
+    running_ = false;
+}
+
+bool EventLoop::isRunning()
+{
+    return running_;
+}
+
+EventLoop::~EventLoop()
+{
+    if(epollFd_ >= 0) close(epollFd_);
+}
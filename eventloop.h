@@ -0,0 +1,45 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include <sys/epoll.h>
+
+class EventLoop
+{
+private:
+    int epollFd_ = -1;
+    bool running_ = false;
+    std::unordered_map<int, std::function<void(uint32_t)>> callbacks_;
+    
+public:
+    static constexpr int MAX_EVENTS = 16;
+    
+    EventLoop();
+    ~EventLoop();
+    bool isOpen();
+    bool add(int fd, std::function<void(uint32_t)> callback, uint32_t events = EPOLLIN);
+    void remove(int fd);
+    bool contains(int fd);
+    void wait(int timeoutMs = -1);
+    void stop();
+    bool isRunning();
+};
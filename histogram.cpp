@@ -0,0 +1,87 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "histogram.h"
+#include <algorithm>
+
+static size_t bucketIndex(uint64_t value)
+{
+    size_t bucket = 0;
+    while(value != 0 && bucket < Histogram::BUCKETS-1)
+    {
+        value >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void Histogram::record(uint64_t value)
+{
+    ++counts_[bucketIndex(value)];
+    ++count_;
+    sum_ += value;
+    max_ = std::max(max_, value);
+}
+
+uint64_t Histogram::bucketUpperBound(size_t bucket)
+{
+    return bucket == 0 ? 0 : (static_cast<uint64_t>(1) << bucket) - 1;
+}
+
+uint64_t Histogram::percentile(double fraction) const
+{
+    if(count_ == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(fraction*count_);
+    if(rank >= count_) rank = count_-1;
+    uint64_t seen = 0;
+    for(size_t i = 0; i < BUCKETS; ++i)
+    {
+        seen += counts_[i];
+        if(seen > rank) return std::min(bucketUpperBound(i), max_);
+    }
+    return max_;
+}
+
+uint64_t Histogram::getCount() const
+{
+    return count_;
+}
+
+uint64_t Histogram::getSum() const
+{
+    return sum_;
+}
+
+uint64_t Histogram::getMax() const
+{
+    return max_;
+}
+
+uint64_t Histogram::getBucketCount(size_t bucket) const
+{
+    return bucket < BUCKETS ? counts_[bucket] : 0;
+}
+
+std::string Histogram::summary() const
+{
+    return "count: " + std::to_string(count_) + 
+           " p50: " + std::to_string(percentile(0.5)) + 
+           " p99: " + std::to_string(percentile(0.99)) + 
+           " max: " + std::to_string(max_);
+}
@@ -0,0 +1,47 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <array>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+class Histogram
+{
+public:
+    //bucket i counts values in [2^(i-1), 2^i), bucket 0 counts zero
+    static constexpr size_t BUCKETS = 40;
+    
+private:
+    std::array<uint64_t, BUCKETS> counts_ = {};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+    
+public:
+    void record(uint64_t value);
+    uint64_t percentile(double fraction) const;
+    uint64_t getCount() const;
+    uint64_t getSum() const;
+    uint64_t getMax() const;
+    uint64_t getBucketCount(size_t bucket) const;
+    std::string summary() const;
+    static uint64_t bucketUpperBound(size_t bucket);
+};
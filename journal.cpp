@@ -0,0 +1,133 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "journal.h"
+#include <iostream>
+#include <atomic>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "process.h"
+#include "debug.h"
+
+Journal::~Journal()
+{
+    close();
+}
+
+bool Journal::open(const std::string& fileName)
+{
+    close();
+    fd_ = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if(fd_ < 0 || ftruncate(fd_, SIZE) < 0)
+    {
+        std::cerr<<"Can not open journal "<<fileName<<": "<<strerror(errno)<<'\n';
+        close();
+        return false;
+    }
+    void* map = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if(map == MAP_FAILED)
+    {
+        std::cerr<<"Can not map journal "<<fileName<<": "<<strerror(errno)<<'\n';
+        close();
+        return false;
+    }
+    header_ = static_cast<Header*>(map);
+    entries_ = reinterpret_cast<Entry*>(header_ + 1);
+    
+    //a new or foreign file is reset, there is nothing to recover from it
+    if(header_->magic != MAGIC || header_->version != VERSION || header_->capacity != CAPACITY)
+    {
+        memset(map, 0, SIZE);
+        header_->version = VERSION;
+        header_->capacity = CAPACITY;
+        header_->magic = MAGIC;
+    }
+    return true;
+}
+
+void Journal::close()
+{
+    if(header_) munmap(header_, SIZE);
+    if(fd_ >= 0) ::close(fd_);
+    header_ = nullptr;
+    entries_ = nullptr;
+    fd_ = -1;
+}
+
+bool Journal::isOpen()
+{
+    return header_ != nullptr;
+}
+
+Journal::Entry* Journal::find(int32_t pid, uint64_t starttime, State state)
+{
+    for(uint32_t i = 0; i < CAPACITY; ++i)
+    {
+        if(entries_[i].pid == pid && entries_[i].starttime == starttime && entries_[i].state == state) return &entries_[i];
+    }
+    return nullptr;
+}
+
+bool Journal::record(Process& process, State state)
+{
+    if(!isOpen() || process.getPid() <= 0) return false;
+    uint64_t starttime = process.getStartTime();
+    if(find(process.getPid(), starttime, state)) return true;
+    //a slot is free once its pid is zero, even if a crash left the rest of it half written
+    Entry* entry = nullptr;
+    for(uint32_t i = 0; i < CAPACITY && !entry; ++i) if(entries_[i].pid == 0) entry = &entries_[i];
+    if(entry == nullptr) return false;
+    
+    //the pid is written last, the process can be killed between any two stores
+    entry->starttime = starttime;
+    entry->state = state;
+    std::atomic_signal_fence(std::memory_order_release);
+    entry->pid = process.getPid();
+    return true;
+}
+
+void Journal::erase(Process& process, State state)
+{
+    if(!isOpen()) return;
+    Entry* entry = find(process.getPid(), process.getStartTime(), state);
+    if(entry == nullptr) return;
+    entry->pid = 0;
+    std::atomic_signal_fence(std::memory_order_release);
+    entry->state = FREE;
+    entry->starttime = 0;
+}
+
+std::vector<Journal::Entry> Journal::getEntries()
+{
+    std::vector<Entry> entries;
+    if(!isOpen()) return entries;
+    for(uint32_t i = 0; i < CAPACITY; ++i)
+    {
+        if(entries_[i].pid > 0 && entries_[i].state != FREE) entries.push_back(entries_[i]);
+    }
+    return entries;
+}
+
+void Journal::clear()
+{
+    if(!isOpen()) return;
+    memset(entries_, 0, CAPACITY*sizeof(Entry));
+}
@@ -0,0 +1,77 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class Process;
+
+class Journal
+{
+public:
+    enum State : uint32_t
+    {
+        FREE = 0,
+        STOPPED = 1,
+        DEMOTED = 2
+    };
+    
+    struct Entry
+    {
+        int32_t pid;
+        uint32_t state;
+        uint64_t starttime;
+    };
+    
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t capacity;
+        uint32_t reserved;
+    };
+    
+    static constexpr uint32_t MAGIC = 0x6c6a7373;
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t CAPACITY = 255;
+    static constexpr size_t SIZE = sizeof(Header) + CAPACITY*sizeof(Entry);
+    static_assert(sizeof(Entry) == 16 && SIZE == 4096, "the journal layout is fixed");
+    
+    int fd_ = -1;
+    Header* header_ = nullptr;
+    Entry* entries_ = nullptr;
+    
+    Entry* find(int32_t pid, uint64_t starttime, State state);
+    
+public:
+    Journal(){}
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+    bool open(const std::string& fileName);
+    void close();
+    bool isOpen();
+    bool record(Process& process, State state);
+    void erase(Process& process, State state);
+    std::vector<Entry> getEntries();
+    void clear();
+};
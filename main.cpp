@@ -31,43 +31,47 @@
 #include <list>
 #include <signal.h>
 #include <sys/stat.h>
+#include <sys/signalfd.h>
+#include <sys/inotify.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unordered_map>
+#include <functional>
 #include <cstring>
-#include <filesystem>
 
 #include "xinstance.h"
 #include "process.h"
+#include "processtree.h"
+#include "procconnector.h"
+#include "cgroupfreezer.h"
+#include "blacklist.h"
 #include "split.h"
 #include "debug.h"
 #include "argpopt.h"
-#include "CppTimer.h"
+#include "eventloop.h"
+#include "timerqueue.h"
+#include "metrics.h"
+#include "memoryadvisor.h"
+#include "journal.h"
+#include "cpusampler.h"
+#include "accounting.h"
 
-Window intraCommesWindow;
-volatile bool configStale = false;
 XInstance xinstance;
+Journal journal;
+Accounting accounting;
 
 constexpr char configPrefix[] = "/.config/sigstoped/";
-constexpr char STOP_EVENT = 65;
-constexpr char PROC_STOP_EVENT = 1;
+constexpr char blacklistName[] = "blacklist";
+constexpr char savingsName[] = "savings";
 
-void sigTerm(int dummy) 
+struct PendingStop
 {
-    XClientMessageEvent event;
-    memset(&event, 0, sizeof(XClientMessageEvent));
-    event.type = ClientMessage;
-    event.window = intraCommesWindow;
-    event.format = 8;
-    event.data.b[0] = STOP_EVENT;
-    XLockDisplay(xinstance.display);
-    XSendEvent(xinstance.display, intraCommesWindow, 0, 0, (XEvent*)&event);
-    XUnlockDisplay(xinstance.display);
-    xinstance.flush();
-}
-
-void sigUser1(int dummy)
-{
-    configStale = true;
-}
-
+    Process process;
+    Rule rule;
+    TimerQueue::TimerId timer = TimerQueue::INVALID_TIMER;
+    std::vector<TimerQueue::TimerId> stageTimers;
+    CpuSampler cpu;
+};
 
 std::string getConfdir()
 {
@@ -78,16 +82,12 @@ std::string getConfdir()
         return std::string();
     }
     const std::string configDir(std::string(homeDir)+configPrefix);
-    if (std::filesystem::exists(configDir)) 
-    {
-        return std::string(homeDir)+configPrefix;
-    }
-    else if(!std::filesystem::create_directory(configDir, homeDir))
+    if(mkdir(configDir.c_str(), 0755) < 0 && errno != EEXIST)
     {
         std::cout<<"Can't create "<<configDir<<'\n';
         return std::string();
     }
-    else return std::string(homeDir)+configPrefix;
+    return configDir;
 }
 
 std::vector<std::string> getApplicationlist(const std::string& fileName)
@@ -114,67 +114,35 @@ std::vector<std::string> getApplicationlist(const std::string& fileName)
     return split(blacklistString);
 }
 
-bool createPidFile(const std::string& fileName)
+int createPidFile(const std::string& fileName)
 {
-    if(std::filesystem::exists(fileName))
+    //the lock is released by the kernel when sigstoped exits in any way, so a left over
+    //file never blocks the next start and no process scan is needed to detect it
+    int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd < 0)
     {
-        std::cerr<<fileName<<" pid file exsists, only one instance may run at once\n";
-        std::string sigstopedName = Process(getpid()).getName();
-        if(Process::byName(sigstopedName).size() > 1) return false;
-        else
-        {
-            std::cerr<<"Only one "
-                     <<sigstopedName
-                     <<" process exists, either sigstoped died or you have several diferently named binarys\n";
-                     
-            std::filesystem::remove(fileName);
-            return createPidFile(fileName);
-        }
+        std::cerr<<"Can not create "<<fileName<<": "<<strerror(errno)<<'\n';
+        return -1;
     }
-    else
+    if(flock(fd, LOCK_EX | LOCK_NB) < 0)
     {
-        std::fstream pidFile;
-        pidFile.open(fileName, std::fstream::out);
-        if(!pidFile.is_open())
-        {
-            std::cerr<<"Can not create "<<fileName<<std::endl;
-            return false;
-        }
-        else
-        {
-            pidFile<<getpid();
-            pidFile.close();
-            return true;
-        }
+        if(errno == EWOULDBLOCK) std::cerr<<fileName<<" is locked, only one instance may run at once\n";
+        else std::cerr<<"Can not lock "<<fileName<<": "<<strerror(errno)<<'\n';
+        close(fd);
+        return -1;
     }
+    std::string pid = std::to_string(getpid()) + '\n';
+    if(ftruncate(fd, 0) < 0 || write(fd, pid.c_str(), pid.size()) != static_cast<ssize_t>(pid.size()))
+        std::cerr<<"Can not write "<<fileName<<'\n';
+    return fd;
 }
 
 
-void sendEventProcStop()
+bool stopProcess(Process process, XInstance* xinstance, bool children)
 {
-    XClientMessageEvent event;
-    memset(&event, 0, sizeof(XClientMessageEvent));
-    event.type = ClientMessage;
-    event.window = intraCommesWindow;
-    event.format = 8;
-    event.data.b[0] = PROC_STOP_EVENT;
-    XLockDisplay(xinstance.display);
-    XSendEvent(xinstance.display, intraCommesWindow, 0, 0, (XEvent*)&event);
-    XUnlockDisplay(xinstance.display);
-    xinstance.flush();
-}
-
-bool stopProcess(Process process, XInstance* xinstance)
-{
-    bool hasTopLevelWindow = false;
-    std::vector<Window> tlWindows = xinstance->getTopLevelWindows();
-    for(auto& window : tlWindows) 
+    if(xinstance->hasWindow(process.getPid()))
     {
-        if(xinstance->getPid(window) == process.getPid()) hasTopLevelWindow = true;
-    }
-    if(hasTopLevelWindow)
-    {
-        process.stop(true);
+        process.stop(children);
         std::cout<<"Stoping pid: "+std::to_string(process.getPid())+" name: "+process.getName()<<'\n';
         return true;
     }
@@ -185,8 +153,82 @@ bool stopProcess(Process process, XInstance* xinstance)
     }
 }
 
+bool removeStopped(Process process, std::list<Process>& stoppedProcs, EventLoop& loop)
+{
+    bool removed = false;
+    for(auto stopped = stoppedProcs.begin(); stopped != stoppedProcs.end();)
+    {
+        if(*stopped == process)
+        {
+            if(stopped->getPidFd() >= 0) loop.remove(stopped->getPidFd());
+            journal.erase(*stopped, Journal::STOPPED);
+            accounting.resumed(*stopped);
+            stopped = stoppedProcs.erase(stopped);
+            removed = true;
+        }
+        else ++stopped;
+    }
+    return removed;
+}
+
+bool removeDemoted(Process process, std::unordered_map<pid_t, Process>& demotedProcs)
+{
+    auto demoted = demotedProcs.find(process.getPid());
+    if(demoted == demotedProcs.end() || demoted->second != process) return false;
+    journal.erase(demoted->second, Journal::DEMOTED);
+    demotedProcs.erase(demoted);
+    return true;
+}
+
+//a stopped or demoted process shares one watch, a pidfd becomes readable once its process has exited
+void watchExit(Process process, std::list<Process>& stoppedProcs, std::unordered_map<pid_t, Process>& demotedProcs, EventLoop& loop)
+{
+    if(process.getPidFd() < 0 || loop.contains(process.getPidFd())) return;
+    loop.add(process.getPidFd(), [process, &stoppedProcs, &demotedProcs, &loop](uint32_t events) mutable
+    {
+        bool stopped = removeStopped(process, stoppedProcs, loop);
+        if(removeDemoted(process, demotedProcs)) process.forgetIdle();
+        loop.remove(process.getPidFd());
+        std::cout<<(stopped ? "Stoped" : "Demoted")<<" pid: "<<process.getPid()<<" name: "<<process.getName()<<" exited\n";
+        if(Process::freezer) Process::freezer->release(process);
+    });
+}
+
+void addStopped(Process process, std::list<Process>& stoppedProcs, std::unordered_map<pid_t, Process>& demotedProcs, EventLoop& loop)
+{
+    if(std::find(stoppedProcs.begin(), stoppedProcs.end(), process) != stoppedProcs.end()) return;
+    stoppedProcs.push_back(process);
+    journal.record(process, Journal::STOPPED);
+    accounting.stopped(process);
+    watchExit(process, stoppedProcs, demotedProcs, loop);
+}
+
+void prefaultTree(Process process, bool descendants)
+{
+    //MADV_WILLNEED only queues the swap-in, so this is cheap enough to do before a resume
+    uint64_t startTime = Metrics::now();
+    size_t bytes = 0;
+    if(descendants)
+    {
+        std::vector<pid_t> pids = process.getDescendants();
+        for(const auto& pid : pids) 
+        {
+            Process descendant(pid);
+            bytes += MemoryAdvisor::prefault(descendant, false);
+        }
+    }
+    else
+    {
+        bytes = MemoryAdvisor::prefault(process, false);
+    }
+    Metrics::prefault.record(Metrics::now() - startTime);
+    if(bytes > 0) std::cout<<"Prefaulting "<<bytes/1024<<"KiB of pid: "<<process.getPid()<<" name: "<<process.getName()
+        <<(descendants ? " descendants\n" : "\n");
+}
+
 int main(int argc, char* argv[])
 {
+    uint64_t startupTime = Metrics::now();
     char* xDisplayName = std::getenv( "DISPLAY" );
     if(xDisplayName == nullptr) 
     {
@@ -194,8 +236,6 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    if(!xinstance.open(xDisplayName)) exit(1);
-    
     Config config;
     argp_parse(&argp, argc, argv, 0, 0, &config);
 
@@ -205,106 +245,440 @@ int main(int argc, char* argv[])
         XInstance::ignoreClientMachine = true;
     }
     
+    if(!xinstance.open(xDisplayName)) exit(1);
+    
+    if(!Process::setProcRoot("/proc"))
+    {
+        std::cerr<<"proc must be mounted!\n";
+        return 1;
+    }
+    
     std::string confDir = getConfdir();
     if(confDir.size() == 0) return 1;
     
-    if(!createPidFile(confDir+"pidfile")) return 1;
+    int pidFd = createPidFile(confDir+"pidfile");
+    if(pidFd < 0) return 1;
     
-    std::vector<std::string> applicationNames = getApplicationlist(confDir+"blacklist");
+    Blacklist blacklist;
+    blacklist.load(getApplicationlist(confDir+blacklistName));
     
-    if(applicationNames.size() == 0) std::cout<<"WARNIG: no application names configured.\n";
+    if(blacklist.empty()) std::cout<<"WARNIG: no application names configured.\n";
+        
+    ProcessTree processTable;
+    ProcConnector connector(&processTable);
+    if(config.procConnector)
+    {
+        if(connector.open()) Process::processTable = &processTable;
+        else std::cout<<"WARNING: proc connector unavailable, falling back to scanning /proc\n";
+    }
     
-    if( !std::filesystem::exists("/proc") )
+    CgroupFreezer freezer;
+    if(config.cgroupFreezer)
     {
-        std::cerr<<"proc must be mounted!\n";
-        return 1;
+        if(freezer.open()) 
+        {
+            Process::freezer = &freezer;
+            std::cout<<"Using cgroup freezer at "<<freezer.getBase()<<'\n';
+        }
+        else std::cout<<"WARNING: cgroup freezer unavailable, falling back to SIGSTOP\n";
     }
     
-    std::list<Process> stoppedProcs;
+    if((config.reclaimDelaySecs >= 0 && !(Process::freezer && freezer.reclaimAvailable())) || config.prefault)
+    {
+        if(!MemoryAdvisor::permitted())
+            std::cout<<"WARNING: sigstoped lacks CAP_SYS_NICE, memory of stopped processes will not be reclaimed or prefaulted\n";
+        else if(!MemoryAdvisor::available())
+            std::cout<<"WARNING: process_madvise is unavailable, memory of stopped processes will not be reclaimed or prefaulted\n";
+    }
+    if(config.idleDelaySecs >= 0 && !Process::freezer && !Process::idleReversible())
+        std::cout<<"WARNING: sigstoped lacks CAP_SYS_NICE, programs will not be moved to idle priority\n";
+    if(config.throttleDelaySecs >= 0 && !Process::freezer)
+        std::cout<<"WARNING: throttling requires the cgroup backend\n";
     
-    intraCommesWindow = XCreateSimpleWindow(xinstance.display, 
-                                            RootWindow(xinstance.display, xinstance.screen),
-                                            10, 10, 10, 10, 0, 0, 0);
-    XSelectInput(xinstance.display, intraCommesWindow, StructureNotifyMask);
-    XSelectInput(xinstance.display, RootWindow(xinstance.display, xinstance.screen), PropertyChangeMask | StructureNotifyMask);
+    EventLoop loop;
+    if(!loop.isOpen()) return 1;
     
+    std::list<Process> stoppedProcs;
     XEvent event;
     Process prevProcess;
-    Process qeuedToStop;
+    const Rule* prevRule = nullptr;
     Window prevWindow = 0;
     
-    signal(SIGINT, sigTerm);
-    signal(SIGTERM, sigTerm);
-    signal(SIGHUP, sigTerm);
-    signal(SIGUSR1, sigUser1);
+    TimerQueue timers;
+    if(!timers.isOpen()) return 1;
+    loop.add(timers.getFd(), [&timers](uint32_t events){timers.handleExpired();});
+    std::unordered_map<pid_t, PendingStop> pendingStops;
+    std::unordered_map<pid_t, Process> demotedProcs;
+    CpuSampler foregroundUsage;
     
-    CppTimer timer;
+    auto cancelPending = [&timers](PendingStop& pending)
+    {
+        timers.cancel(pending.timer);
+        for(const auto& id : pending.stageTimers) timers.cancel(id);
+    };
     
-    while(true)
+    //undoes every demotion stage at once
+    auto promote = [&demotedProcs, &stoppedProcs, &loop](Process process)
     {
-        XNextEvent(xinstance.display, &event);
-        if (event.type == DestroyNotify) break;
-        else if (event.type == PropertyNotify && event.xproperty.atom == xinstance.atoms.netActiveWindow)
+        auto demoted = demotedProcs.find(process.getPid());
+        if(demoted == demotedProcs.end() || demoted->second != process) return;
+        Process promoted = demoted->second;
+        promoted.throttle(0);
+        promoted.setIdle(false, true);
+        removeDemoted(promoted, demotedProcs);
+        if(promoted.getPidFd() >= 0 && std::find(stoppedProcs.begin(), stoppedProcs.end(), promoted) == stoppedProcs.end())
+            loop.remove(promoted.getPidFd());
+    };
+    
+    uint64_t nextReclaimSlot = 0;
+    auto scheduleReclaim = [&timers, &stoppedProcs, &config, &nextReclaimSlot](Process process, bool children)
+    {
+        //reclaims are spaced out so that stopping many applications at once does not thrash swap
+        constexpr uint64_t NS = 1000000000;
+        uint64_t now = TimerQueue::now();
+        uint64_t deadline = std::max(now + config.reclaimDelaySecs*NS, nextReclaimSlot);
+        nextReclaimSlot = deadline + config.reclaimIntervalSecs*NS;
+        timers.add((deadline - now)/NS, (deadline - now)%NS, [process, children, &stoppedProcs]() mutable
+        {
+            if(std::find(stoppedProcs.begin(), stoppedProcs.end(), process) == stoppedProcs.end()) return;
+            uint64_t startTime = Metrics::now();
+            long long bytes = Process::freezer ? Process::freezer->reclaim(process) : -1;
+            long pages = bytes >= 0 ? bytes/sysconf(_SC_PAGESIZE) : MemoryAdvisor::pageout(process, children);
+            std::cout<<"Reclaimed "<<pages<<" pages from pid: "<<process.getPid()<<" name: "<<process.getName()
+                <<" in "<<(Metrics::now() - startTime)/1000<<"ms\n";
+            if(pages > 0) Metrics::reclaimedPages += pages;
+        });
+    };
+    
+    auto scheduleDemotion = [&timers, &pendingStops, &demotedProcs, &stoppedProcs, &loop](Process toDemote, int delaySecs, int throttlePercent)
+    {
+        return timers.add(delaySecs, 0, [toDemote, throttlePercent, &pendingStops, &demotedProcs, &stoppedProcs, &loop]() mutable
         {
+            auto pending = pendingStops.find(toDemote.getPid());
+            bool children = pending == pendingStops.end() || pending->second.rule.children;
+            bool demoted = throttlePercent > 0 ? toDemote.throttle(throttlePercent) : toDemote.setIdle(true, children);
+            if(!demoted) return;
+            toDemote.pin();
+            demotedProcs[toDemote.getPid()] = toDemote;
+            journal.record(toDemote, Journal::DEMOTED);
+            watchExit(toDemote, stoppedProcs, demotedProcs, loop);
+            std::cout<<"Demoting pid: "<<toDemote.getPid()<<" name: "<<toDemote.getName()<<" to ";
+            if(throttlePercent > 0) std::cout<<throttlePercent<<"% cpu\n";
+            else std::cout<<"idle priority\n";
+        });
+    };
+    
+    std::function<void(Process)> deferredStop = [&timers, &pendingStops, &stoppedProcs, &demotedProcs, &loop, &connector, &config, &promote, &scheduleReclaim, &deferredStop](Process toStop)
+    {
+        uint64_t startTime = Metrics::now();
+        auto pending = pendingStops.find(toStop.getPid());
+        if(pending == pendingStops.end()) return;
+        bool children = pending->second.rule.children;
+        
+        bool sampled = !pending->second.cpu.empty();
+        double usage = sampled ? pending->second.cpu.sample() : 0;
+        if(config.accounting && sampled) accounting.addBackground(toStop.getName(), pending->second.cpu);
+        
+        //trees that idle in the background gain nothing from being stopped
+        if(config.cpuThreshold > 0 && !pending->second.cpu.empty())
+        {
+            if(usage < config.cpuThreshold)
+            {
+                std::cout<<"Not stoping pid: "<<toStop.getPid()<<" name: "<<toStop.getName()<<" using "<<usage
+                    <<"% cpu, checking again in "<<config.cpuRecheckSecs<<"s\n";
+                pending->second.cpu.start(toStop, children, config.accounting);
+                pending->second.timer = timers.add(config.cpuRecheckSecs, 0, [toStop, &deferredStop](){deferredStop(toStop);});
+                return;
+            }
+        }
+        
+        pendingStops.erase(pending);
+        connector.handleMessages();
+        if(stopProcess(toStop, &xinstance, children)) 
+        {
+            addStopped(toStop, stoppedProcs, demotedProcs, loop);
+            Metrics::stopLatency.record(Metrics::now() - startTime);
+            if(config.reclaimDelaySecs >= 0) scheduleReclaim(toStop, children);
+        }
+        else
+        {
+            //without a window the process can never be focused again to undo its demotion
+            promote(toStop);
+        }
+    };
+    
+    auto scheduleStop = [&timers, &pendingStops, &config, &scheduleDemotion, &deferredStop](Process toStop, const Rule& rule)
+    {
+        if(pendingStops.find(toStop.getPid()) != pendingStops.end()) return;
+        int timeoutSecs = rule.timeoutSecs >= 0 ? rule.timeoutSecs : config.timeoutSecs;
+        std::cout<<"Will stop pid: "<<toStop.getPid()<<" name: "<<toStop.getName()<<" in "<<timeoutSecs<<"s\n";
+        
+        PendingStop& pending = pendingStops[toStop.getPid()];
+        pending.process = toStop;
+        pending.rule = rule;
+        if(config.cpuThreshold > 0 || config.accounting) pending.cpu.start(toStop, rule.children, config.accounting);
+        
+        //demotion stages only make sense before the stop
+        if(config.idleDelaySecs >= 0 && config.idleDelaySecs < timeoutSecs)
+            pending.stageTimers.push_back(scheduleDemotion(toStop, config.idleDelaySecs, 0));
+        if(config.throttleDelaySecs >= 0 && config.throttleDelaySecs < timeoutSecs)
+            pending.stageTimers.push_back(scheduleDemotion(toStop, config.throttleDelaySecs, config.throttlePercent));
+        
+        pending.timer = timers.add(timeoutSecs, 0, [toStop, &deferredStop](){deferredStop(toStop);});
+    };
+    
+    auto reloadBlacklist = [&]()
+    {
+        Blacklist oldBlacklist = blacklist;
+        blacklist.load(getApplicationlist(confDir+blacklistName));
+        std::cout<<"Reloaded blacklist, "<<blacklist.size()<<" rules\n";
+        
+        //only processes whose rule went away are woken up
+        for(auto stopped = stoppedProcs.begin(); stopped != stoppedProcs.end();)
+        {
+            const Rule* rule = blacklist.match(*stopped);
+            if(rule)
+            {
+                stopped->setSignalMode(rule->signalMode);
+                ++stopped;
+                continue;
+            }
+            std::cout<<"Resumeing pid: "<<stopped->getPid()<<" name: "<<stopped->getName()<<" no longer blacklisted\n";
+            promote(*stopped);
+            stopped->resume(true);
+            if(stopped->getPidFd() >= 0) loop.remove(stopped->getPidFd());
+            journal.erase(*stopped, Journal::STOPPED);
+            accounting.resumed(*stopped);
+            stopped = stoppedProcs.erase(stopped);
+        }
+        for(auto pending = pendingStops.begin(); pending != pendingStops.end();)
+        {
+            const Rule* rule = blacklist.match(pending->second.process);
+            if(rule)
+            {
+                pending->second.process.setSignalMode(rule->signalMode);
+                pending->second.rule = *rule;
+                ++pending;
+                continue;
+            }
+            cancelPending(pending->second);
+            promote(pending->second.process);
+            pending = pendingStops.erase(pending);
+        }
+        
+        prevRule = blacklist.match(prevProcess);
+        if(prevRule) prevProcess.setSignalMode(prevRule->signalMode);
+        
+        //background applications that only now match a rule become eligible for stopping
+        std::vector<pid_t> clientPids = xinstance.getClientPids();
+        for(const auto& pid : clientPids)
+        {
+            Process process(pid);
+            if(process == prevProcess) continue;
+            const Rule* rule = blacklist.match(process);
+            if(!rule || oldBlacklist.match(process)) continue;
+            process.pin();
+            process.setSignalMode(rule->signalMode);
+            scheduleStop(process, *rule);
+        }
+    };
+    
+    const std::string metricsFileName = confDir + "sigstoped.prom";
+    auto writeMetrics = [&metricsFileName, &stoppedProcs, &config, &confDir]()
+    {
+        Metrics::stoppedProcesses = stoppedProcs.size();
+        if(!Metrics::write(metricsFileName)) std::cerr<<"Can not write "<<metricsFileName<<'\n';
+        if(config.accounting && !accounting.write(confDir+savingsName)) std::cerr<<"Can not write "<<confDir+savingsName<<'\n';
+    };
+    std::function<void()> periodicWrite;
+    if(config.metricsIntervalSecs > 0)
+    {
+        periodicWrite = [&timers, &writeMetrics, &periodicWrite, &config]()
+        {
+            writeMetrics();
+            timers.add(config.metricsIntervalSecs, 0, periodicWrite);
+        };
+        timers.add(config.metricsIntervalSecs, 0, periodicWrite);
+    }
+    
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    int signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if(signalFd < 0)
+    {
+        std::cerr<<"Can not create signalfd\n";
+        return 1;
+    }
+    loop.add(signalFd, [signalFd, &loop, &writeMetrics, &reloadBlacklist](uint32_t events)
+    {
+        signalfd_siginfo info;
+        while(read(signalFd, &info, sizeof(info)) == sizeof(info))
+        {
+            if(info.ssi_signo == SIGUSR1) reloadBlacklist();
+            else if(info.ssi_signo == SIGUSR2) writeMetrics();
+            else loop.stop();
+        }
+    });
+    
+    int inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotifyFd < 0 || inotify_add_watch(inotifyFd, confDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        std::cout<<"WARNING: can not watch "<<confDir<<", send SIGUSR1 to reload the blacklist\n";
+    }
+    else
+    {
+        loop.add(inotifyFd, [inotifyFd, &reloadBlacklist](uint32_t events)
+        {
+            alignas(inotify_event) char buffer[4096];
+            bool changed = false;
+            ssize_t length;
+            while((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                for(char* ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(ptr)->len)
+                {
+                    inotify_event* event = reinterpret_cast<inotify_event*>(ptr);
+                    if(event->len > 0 && strcmp(event->name, blacklistName) == 0) changed = true;
+                }
+            }
+            if(changed) reloadBlacklist();
+        });
+    }
+    
+    if(connector.isOpen()) loop.add(connector.getFd(), [&connector](uint32_t events){connector.handleMessages();});
+    
+    //X events are drained with XPending below, the fd only has to wake the loop
+    loop.add(ConnectionNumber(xinstance.display), [](uint32_t events){});
+    XSelectInput(xinstance.display, RootWindow(xinstance.display, xinstance.screen), PropertyChangeMask | StructureNotifyMask);
+    
+    //processes a previous instance left stopped or demoted are taken over, or released if they
+    //are no longer blacklisted or have been focused in the meantime
+    if(journal.open(confDir+"journal"))
+    {
+        std::vector<Journal::Entry> entries = journal.getEntries();
+        journal.clear();
+        Window activeWindow = xinstance.getActiveWindow();
+        pid_t activePid = activeWindow != 0 ? xinstance.getPid(activeWindow) : -1;
+        for(const auto& entry : entries)
+        {
+            Process process(entry.pid);
+            if(process.getStartTime() != entry.starttime) continue;
+            process.pin();
+            if(entry.state == Journal::DEMOTED)
+            {
+                process.throttle(0);
+                process.setIdle(false, true);
+                continue;
+            }
+            const Rule* rule = blacklist.match(process);
+            if(rule && process.getPid() != activePid)
+            {
+                std::cout<<"Readopting stoped pid: "<<process.getPid()<<" name: "<<process.getName()<<'\n';
+                process.setSignalMode(rule->signalMode);
+                process.stop(rule->children);
+                addStopped(process, stoppedProcs, demotedProcs, loop);
+            }
+            else
+            {
+                std::cout<<"Resumeing pid: "<<process.getPid()<<" name: "<<process.getName()<<" left stoped by a previous instance\n";
+                process.resume(true);
+            }
+        }
+    }
+    
+    Metrics::startupTime = Metrics::now() - startupTime;
+    std::cout<<"Started in "<<Metrics::startupTime<<"us\n";
+    
+    while(loop.isRunning())
+    {
+        while(loop.isRunning() && XPending(xinstance.display))
+        {
+            XNextEvent(xinstance.display, &event);
+            xinstance.handleEvent(event);
+            if(event.type != PropertyNotify || event.xproperty.atom != xinstance.atoms.netActiveWindow) continue;
+            
+            uint64_t eventTime = Metrics::now();
             Window wid = xinstance.getActiveWindow();
-            if(wid != 0 && wid != prevWindow)
+            if(wid == 0 || wid == prevWindow) continue;
+            
+            pid_t windowPid = xinstance.getPid(wid);
+            Process process(windowPid);
+            process.pin();
+            std::cout<<"Active window: "<<wid<<" pid: "<<process.getPid()<<" name: "<<process.getName()<<'\n';
+            
+            const Rule* rule = prevRule;
+            if(process != prevProcess)
             {
-                pid_t windowPid = xinstance.getPid(wid);
-                Process process(windowPid);
-                std::cout<<"Active window: "<<wid<<" pid: "<<process.getPid()<<" name: "<<process.getName()<<'\n';
-                
-                if(process != prevProcess)
+                rule = blacklist.match(process);
+                if(rule) process.setSignalMode(rule->signalMode);
+                Metrics::decisionLatency.record(Metrics::now() - eventTime);
+                if(!foregroundUsage.empty())
                 {
-                    if(configStale)
-                    {
-                        applicationNames = getApplicationlist(confDir+"blacklist");
-                        configStale = false;
-                        for(auto& process : stoppedProcs) process.resume(true);
-                        stoppedProcs.clear();
-                    }
-                    for(size_t i = 0; i < applicationNames.size(); ++i)
+                    foregroundUsage.sample();
+                    accounting.addForeground(prevProcess.getName(), foregroundUsage);
+                    foregroundUsage.clear();
+                }
+                if(rule) 
+                {
+                    auto pending = pendingStops.find(process.getPid());
+                    if(pending != pendingStops.end())
                     {
-                        if(process.getName() == applicationNames[i] &&  wid != 0 && process.getPid() > 0 && process.getName() != "") 
-                        {
-                            if(process == qeuedToStop)
-                            {
-                                std::cout<<"Canceling stop of wid: "+std::to_string(wid)+" pid: "+std::to_string(process.getPid())+" name: "+process.getName()<<'\n';
-                                timer.stop();
-                                qeuedToStop = Process();
-                            }
-                            process.resume(true);
-                            stoppedProcs.remove(process);
-                            std::cout<<"Resumeing wid: "+std::to_string(wid)+" pid: "+std::to_string(process.getPid())+" name: "+process.getName()<<'\n';
-                        }
-                        else if(prevProcess.getName() == applicationNames[i] && 
-                                prevWindow != 0 && 
-                                prevProcess.getName() != "" && 
-                                prevProcess.getPid() > 0) 
+                        std::cout<<"Canceling stop of wid: "+std::to_string(wid)+" pid: "+std::to_string(process.getPid())+" name: "+process.getName()<<'\n';
+                        if(config.accounting && !pending->second.cpu.empty())
                         {
-                            timer.block();
-                            std::cout<<"Will stop pid: "<<prevProcess.getPid()<<" name: "<<prevProcess.getName()<<'\n';
-                            qeuedToStop = prevProcess;
-                            timer.start(config.timeoutSecs, 0, sendEventProcStop, CppTimer::ONESHOT);
-                            stoppedProcs.push_back(prevProcess);
+                            pending->second.cpu.sample();
+                            accounting.addBackground(process.getName(), pending->second.cpu);
                         }
+                        cancelPending(pending->second);
+                        pendingStops.erase(pending);
                     }
+                    promote(process);
+                    bool prefault = removeStopped(process, stoppedProcs, loop) && config.prefault;
+                    //swap-in is started before each process continues, so that it runs
+                    //in parallel with it instead of behind its first page faults
+                    if(prefault) prefaultTree(process, false);
+                    //the window owner is resumed right away, its descendants only once
+                    //the queued X events are handled, to get the focused ui running first
+                    process.resume(false);
+                    Metrics::resumeLatency.record(Metrics::now() - eventTime);
+                    std::cout<<"Resumeing wid: "+std::to_string(wid)+" pid: "+std::to_string(process.getPid())+" name: "+process.getName()<<'\n';
+                    timers.add(0, 0, [process, prefault, &config, &prevProcess, &foregroundUsage]() mutable 
+                    {
+                        if(prefault) prefaultTree(process, true);
+                        process.resume(true);
+                        if(config.accounting && process == prevProcess) foregroundUsage.start(process, true, true);
+                    });
                 }
-                prevProcess = process;
-                prevWindow = wid;
-            }
-        }
-        else if (event.type == ClientMessage && ((XClientMessageEvent*)&event)->window == intraCommesWindow)
-        {
-            XClientMessageEvent* clientEvent = (XClientMessageEvent*)&event;
-            if (clientEvent->data.b[0] == STOP_EVENT) break;
-            if (clientEvent->data.b[0] == PROC_STOP_EVENT)
-            {
-               stopProcess(qeuedToStop, &xinstance);
-               qeuedToStop = Process();
+                if(prevRule && prevWindow != 0) scheduleStop(prevProcess, *prevRule);
             }
+            prevProcess = process;
+            prevRule = rule;
+            prevWindow = wid;
         }
+        if(loop.isRunning()) loop.wait();
+    }
+    while(!demotedProcs.empty()) promote(demotedProcs.begin()->second);
+    for(auto& process : stoppedProcs) 
+    {
+        process.resume(true);
+        accounting.resumed(process);
+    }
+    if(Process::freezer) 
+    {
+        freezer.thawAll();
+        freezer.prune();
     }
-    for(auto& process : stoppedProcs) process.resume(true);
-    std::filesystem::remove(confDir+"pidfile");
+    if(config.accounting && !accounting.write(confDir+savingsName)) std::cerr<<"Can not write "<<confDir+savingsName<<'\n';
+    journal.clear();
+    std::cout<<"Resume latency [us] "<<Metrics::resumeLatency.summary()<<'\n';
+    std::cout<<"Stop latency [us] "<<Metrics::stopLatency.summary()<<'\n';
+    //the pid file is kept, removing it while locked would let a starting instance lock a stale inode
+    if(ftruncate(pidFd, 0) < 0) debug("Can not truncate pid file");
+    close(pidFd);
     return 0;
 }
@@ -0,0 +1,233 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "memoryadvisor.h"
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "process.h"
+#include "debug.h"
+
+#ifndef SYS_process_madvise
+#define SYS_process_madvise 440
+#endif
+
+#ifndef MADV_WILLNEED
+#define MADV_WILLNEED 3
+#endif
+
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+
+static ssize_t processMadvise(int pidFd, const iovec* iov, size_t count, int advice)
+{
+    return syscall(SYS_process_madvise, pidFd, iov, count, advice, 0);
+}
+
+int MemoryAdvisor::probe()
+{
+    static const int error = []()
+    {
+        if(!Process::pidFdAvailable()) return ENOSYS;
+        Process self(getpid());
+        if(!self.pin()) return ENOSYS;
+        //an empty vector is accepted by every kernel that has the syscall, some kernels
+        //still require CAP_SYS_NICE even when the target is the caller itself
+        if(processMadvise(self.getPidFd(), nullptr, 0, MADV_PAGEOUT) == 0) return 0;
+        return errno;
+    }();
+    return error;
+}
+
+bool MemoryAdvisor::available()
+{
+    return probe() == 0;
+}
+
+bool MemoryAdvisor::permitted()
+{
+    return probe() != EPERM;
+}
+
+//parses a mapping line as found in maps and smaps, returns false for lines that describe no mapping
+static bool parseRegion(const std::string& maps, size_t lineStart, size_t lineEnd, MemoryRegion& region, bool& usable)
+{
+    const char* line = maps.c_str() + lineStart;
+    char* end;
+    uintptr_t start = strtoull(line, &end, 16);
+    if(*end != '-') return false;
+    uintptr_t stop = strtoull(end+1, &end, 16);
+    if(*end != ' ' || stop <= start) return false;
+    region.start = start;
+    region.length = stop - start;
+    region.swap = 0;
+    
+    //the path is the sixth field, special mappings like [vdso] and device mappings are rejected by the kernel,
+    //the search stays within the line as anonymous mappings have no path
+    size_t pathOffset = end - maps.c_str();
+    size_t pathStart = std::string_view(maps).substr(pathOffset, lineEnd - pathOffset).find_first_of("/[");
+    usable = true;
+    region.hot = false;
+    if(pathStart != std::string_view::npos)
+    {
+        pathStart += pathOffset;
+        if(maps.compare(pathStart, 5, "/dev/") == 0) usable = false;
+        else if(maps.compare(pathStart, 6, "[heap]") == 0 || maps.compare(pathStart, 7, "[stack]") == 0) region.hot = true;
+        else if(maps[pathStart] == '[') usable = false;
+    }
+    return true;
+}
+
+std::vector<MemoryRegion> MemoryAdvisor::getRegions(Process& process)
+{
+    std::vector<MemoryRegion> regions;
+    std::string maps = process.readFile("maps");
+    size_t lineStart = 0;
+    while(lineStart < maps.size())
+    {
+        size_t lineEnd = maps.find('\n', lineStart);
+        if(lineEnd == std::string::npos) lineEnd = maps.size();
+        MemoryRegion region;
+        bool usable;
+        if(parseRegion(maps, lineStart, lineEnd, region, usable) && usable) regions.push_back(region);
+        lineStart = lineEnd + 1;
+    }
+    return regions;
+}
+
+std::vector<MemoryRegion> MemoryAdvisor::getSwappedRegions(Process& process, size_t maxRegions)
+{
+    std::vector<MemoryRegion> regions;
+    std::string smaps = process.readFile("smaps");
+    MemoryRegion region;
+    bool usable = false;
+    bool inRegion = false;
+    size_t lineStart = 0;
+    while(lineStart < smaps.size())
+    {
+        size_t lineEnd = smaps.find('\n', lineStart);
+        if(lineEnd == std::string::npos) lineEnd = smaps.size();
+        //the fields of a mapping follow its header line
+        if(smaps.compare(lineStart, 5, "Swap:") == 0)
+        {
+            if(inRegion) regions.back().swap = strtoull(smaps.c_str() + lineStart + 5, nullptr, 10)*1024;
+        }
+        else if(parseRegion(smaps, lineStart, lineEnd, region, usable))
+        {
+            inRegion = usable;
+            if(usable) regions.push_back(region);
+        }
+        lineStart = lineEnd + 1;
+    }
+    
+    regions.erase(std::remove_if(regions.begin(), regions.end(), 
+                                 [](const MemoryRegion& region){return region.swap == 0 && !region.hot;}), regions.end());
+    if(regions.size() > maxRegions)
+    {
+        std::partial_sort(regions.begin(), regions.begin()+maxRegions, regions.end(), 
+                          [](const MemoryRegion& a, const MemoryRegion& b){return a.hot > b.hot || (a.hot == b.hot && a.swap > b.swap);});
+        regions.resize(maxRegions);
+    }
+    //ascending addresses let the kernel walk the vmas in order
+    std::sort(regions.begin(), regions.end(), [](const MemoryRegion& a, const MemoryRegion& b){return a.start < b.start;});
+    return regions;
+}
+
+size_t MemoryAdvisor::advise(Process& process, const std::vector<MemoryRegion>& regions, int advice)
+{
+    if(!available() || !process.pin()) return 0;
+    
+    std::vector<iovec> iov;
+    iov.reserve(std::min(regions.size(), MAX_IOV));
+    size_t advised = 0;
+    size_t index = 0;
+    while(index < regions.size())
+    {
+        iov.clear();
+        for(size_t i = index; i < regions.size() && iov.size() < MAX_IOV; ++i)
+            iov.push_back({reinterpret_cast<void*>(regions[i].start), regions[i].length});
+        
+        ssize_t ret = processMadvise(process.getPidFd(), iov.data(), iov.size(), advice);
+        if(ret < 0)
+        {
+            if(errno == EPERM && !warned_)
+            {
+                std::cerr<<"Not permitted to advise memory of other processes, sigstoped needs CAP_SYS_NICE\n";
+                warned_ = true;
+            }
+            if(errno == EPERM || errno == ESRCH || errno == ENOSYS) break;
+            //the first region was rejected, most likely it was unmapped in the meantime
+            ++index;
+            continue;
+        }
+        
+        //the kernel stops at the first region it rejects and returns the bytes advised up to there
+        advised += ret;
+        size_t done = ret;
+        size_t i = 0;
+        while(i < iov.size() && done >= iov[i].iov_len)
+        {
+            done -= iov[i].iov_len;
+            ++i;
+        }
+        index += i < iov.size() ? i + 1 : i;
+    }
+    return advised;
+}
+
+long MemoryAdvisor::pageout(Process& process, bool children)
+{
+    std::vector<Process> processes({process});
+    if(children)
+    {
+        std::vector<pid_t> descendants = process.getDescendants();
+        for(const auto& pid : descendants) processes.push_back(Process(pid));
+    }
+    
+    long before = 0;
+    for(auto& member : processes) before += std::max(member.getResidentPages(), 0L);
+    for(auto& member : processes) advise(member, getRegions(member), MADV_PAGEOUT);
+    long after = 0;
+    for(auto& member : processes) after += std::max(member.getResidentPages(), 0L);
+    return before - after;
+}
+
+size_t MemoryAdvisor::prefault(Process& process, bool children, size_t maxRegions)
+{
+    std::vector<Process> processes({process});
+    if(children)
+    {
+        std::vector<pid_t> descendants = process.getDescendants();
+        for(const auto& pid : descendants) processes.push_back(Process(pid));
+    }
+    
+    //MADV_WILLNEED only queues swap-in, so this does not wait for the io
+    size_t advised = 0;
+    for(auto& member : processes) advised += advise(member, getSwappedRegions(member, maxRegions), MADV_WILLNEED);
+    return advised;
+}
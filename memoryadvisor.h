@@ -0,0 +1,53 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class Process;
+
+struct MemoryRegion
+{
+    uintptr_t start = 0;
+    size_t length = 0;
+    size_t swap = 0;
+    bool hot = false;
+};
+
+class MemoryAdvisor
+{
+private:
+    static constexpr size_t MAX_IOV = 1024;
+    inline static bool warned_ = false;
+    
+    static int probe();
+    
+public:
+    static bool available();
+    static bool permitted();
+    static constexpr size_t PREFAULT_REGIONS = 64;
+    
+    static std::vector<MemoryRegion> getRegions(Process& process);
+    static std::vector<MemoryRegion> getSwappedRegions(Process& process, size_t maxRegions = PREFAULT_REGIONS);
+    static size_t advise(Process& process, const std::vector<MemoryRegion>& regions, int advice);
+    static long pageout(Process& process, bool children);
+    static size_t prefault(Process& process, bool children, size_t maxRegions = PREFAULT_REGIONS);
+};
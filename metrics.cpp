@@ -0,0 +1,75 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "metrics.h"
+#include <fstream>
+#include <cstdio>
+#include <time.h>
+
+uint64_t Metrics::now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec)*1000000 + time.tv_nsec/1000;
+}
+
+void Metrics::writeHistogram(std::ostream& out, const std::string& name, const std::string& help, 
+                             const Histogram& histogram, double scale)
+{
+    out<<"# HELP "<<name<<' '<<help<<'\n';
+    out<<"# TYPE "<<name<<" histogram\n";
+    uint64_t cumulative = 0;
+    for(size_t i = 0; i < Histogram::BUCKETS; ++i)
+    {
+        cumulative += histogram.getBucketCount(i);
+        out<<name<<"_bucket{le=\""<<Histogram::bucketUpperBound(i)*scale<<"\"} "<<cumulative<<'\n';
+    }
+    out<<name<<"_bucket{le=\"+Inf\"} "<<histogram.getCount()<<'\n';
+    out<<name<<"_sum "<<histogram.getSum()*scale<<'\n';
+    out<<name<<"_count "<<histogram.getCount()<<'\n';
+}
+
+bool Metrics::write(const std::string& fileName)
+{
+    //the textfile collector may read at any time, so the file is replaced atomically
+    const std::string tempName = fileName + ".tmp";
+    std::fstream file(tempName, std::fstream::out | std::fstream::trunc);
+    if(!file.is_open()) return false;
+    
+    constexpr double US = 1e-6;
+    writeHistogram(file, "sigstoped_decision_seconds", "Time from a focus change event to the stop/resume decision", decisionLatency, US);
+    writeHistogram(file, "sigstoped_resume_seconds", "Time from a focus change event to resuming the focused application", resumeLatency, US);
+    writeHistogram(file, "sigstoped_stop_seconds", "Time taken to carry out a deferred stop", stopLatency, US);
+    writeHistogram(file, "sigstoped_x_round_trip_seconds", "Duration of X requests that wait for a reply", xRoundTrip, US);
+    writeHistogram(file, "sigstoped_proc_scan_seconds", "Duration of /proc scans and process tree walks", procScan, US);
+    writeHistogram(file, "sigstoped_prefault_seconds", "Time taken to queue swap-in of a resumed application", prefault, US);
+    writeHistogram(file, "sigstoped_signals_per_operation", "Signals sent per recursive stop or resume", signalsPerOperation, 1);
+    file<<"# HELP sigstoped_stopped_processes Processes currently stopped\n";
+    file<<"# TYPE sigstoped_stopped_processes gauge\n";
+    file<<"sigstoped_stopped_processes "<<stoppedProcesses<<'\n';
+    file<<"# HELP sigstoped_reclaimed_pages_total Pages reclaimed from stopped processes\n";
+    file<<"# TYPE sigstoped_reclaimed_pages_total counter\n";
+    file<<"sigstoped_reclaimed_pages_total "<<reclaimedPages<<'\n';
+    file<<"# HELP sigstoped_startup_seconds Time from starting sigstoped until it entered its event loop\n";
+    file<<"# TYPE sigstoped_startup_seconds gauge\n";
+    file<<"sigstoped_startup_seconds "<<startupTime*US<<'\n';
+    file.close();
+    if(file.fail()) return false;
+    return std::rename(tempName.c_str(), fileName.c_str()) == 0;
+}
@@ -0,0 +1,46 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <string>
+#include <cstdint>
+#include "histogram.h"
+
+class Metrics
+{
+private:
+    static void writeHistogram(std::ostream& out, const std::string& name, const std::string& help, 
+                               const Histogram& histogram, double scale);
+    
+public:
+    //all latencies are recorded in microseconds
+    inline static Histogram decisionLatency;
+    inline static Histogram resumeLatency;
+    inline static Histogram stopLatency;
+    inline static Histogram xRoundTrip;
+    inline static Histogram procScan;
+    inline static Histogram signalsPerOperation;
+    inline static Histogram prefault;
+    inline static uint64_t stoppedProcesses = 0;
+    inline static uint64_t reclaimedPages = 0;
+    inline static uint64_t startupTime = 0;
+    
+    static uint64_t now();
+    static bool write(const std::string& fileName);
+};
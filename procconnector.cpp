@@ -0,0 +1,168 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "procconnector.h"
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include "process.h"
+#include "debug.h"
+
+bool ProcConnector::open()
+{
+    fd_ = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if(fd_ < 0)
+    {
+        std::cerr<<"Can not open netlink connector socket: "<<strerror(errno)<<'\n';
+        return false;
+    }
+    
+    sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = CN_IDX_PROC;
+    address.nl_pid = 0;
+    if(bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || !subscribe(true))
+    {
+        std::cerr<<"Can not subscribe to the proc connector, CAP_NET_ADMIN is required: "<<strerror(errno)<<'\n';
+        close();
+        return false;
+    }
+    
+    //seed the table after subscribing so that no event between the scan and the subscription is lost
+    tree_->update();
+    return true;
+}
+
+bool ProcConnector::subscribe(bool listen)
+{
+    alignas(nlmsghdr) char buffer[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))];
+    memset(buffer, 0, sizeof(buffer));
+    
+    nlmsghdr* header = reinterpret_cast<nlmsghdr*>(buffer);
+    header->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op));
+    header->nlmsg_type = NLMSG_DONE;
+    header->nlmsg_pid = getpid();
+    
+    cn_msg* message = reinterpret_cast<cn_msg*>(NLMSG_DATA(header));
+    message->id.idx = CN_IDX_PROC;
+    message->id.val = CN_VAL_PROC;
+    message->len = sizeof(proc_cn_mcast_op);
+    *reinterpret_cast<proc_cn_mcast_op*>(message->data) = listen ? PROC_CN_MCAST_LISTEN : PROC_CN_MCAST_IGNORE;
+    
+    return send(fd_, buffer, header->nlmsg_len, 0) == static_cast<ssize_t>(header->nlmsg_len);
+}
+
+void ProcConnector::close()
+{
+    if(fd_ < 0) return;
+    subscribe(false);
+    ::close(fd_);
+    fd_ = -1;
+}
+
+bool ProcConnector::isOpen()
+{
+    return fd_ >= 0;
+}
+
+int ProcConnector::getFd()
+{
+    return fd_;
+}
+
+void ProcConnector::handleMessages()
+{
+    if(fd_ < 0) return;
+    alignas(nlmsghdr) char buffer[8192];
+    while(true)
+    {
+        ssize_t length = recv(fd_, buffer, sizeof(buffer), 0);
+        if(length < 0 && errno == ENOBUFS)
+        {
+            //events where dropped, the table can no longer be trusted
+            std::cerr<<"proc connector overrun, rescaning /proc\n";
+            tree_->update();
+            continue;
+        }
+        else if(length <= 0) break;
+        
+        for(nlmsghdr* header = reinterpret_cast<nlmsghdr*>(buffer); 
+            NLMSG_OK(header, static_cast<size_t>(length)); 
+            header = NLMSG_NEXT(header, length))
+        {
+            if(header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP) continue;
+            cn_msg* message = reinterpret_cast<cn_msg*>(NLMSG_DATA(header));
+            if(message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) continue;
+            handleEvent(*reinterpret_cast<proc_event*>(message->data));
+        }
+    }
+}
+
+void ProcConnector::handleEvent(const proc_event& event)
+{
+    ProcStat stat;
+    switch(event.what)
+    {
+        case proc_event::PROC_EVENT_FORK:
+            //threads are not tracked, a forked child inherits the comm of its parent
+            if(event.event_data.fork.child_pid != event.event_data.fork.child_tgid) break;
+            tree_->addProcess(event.event_data.fork.child_tgid, 
+                              event.event_data.fork.parent_tgid, 
+                              tree_->getName(event.event_data.fork.parent_tgid),
+                              tree_->getSession(event.event_data.fork.parent_tgid));
+            break;
+        case proc_event::PROC_EVENT_SID:
+            tree_->setSession(event.event_data.sid.process_tgid, event.event_data.sid.process_tgid);
+            break;
+        case proc_event::PROC_EVENT_EXEC:
+            if(Process::readStat(event.event_data.exec.process_tgid, stat))
+                tree_->setName(event.event_data.exec.process_tgid, stat.comm);
+            break;
+        case proc_event::PROC_EVENT_COMM:
+            if(event.event_data.comm.process_pid != event.event_data.comm.process_tgid) break;
+            tree_->setName(event.event_data.comm.process_tgid, 
+                           std::string(event.event_data.comm.comm, strnlen(event.event_data.comm.comm, sizeof(event.event_data.comm.comm))));
+            break;
+        case proc_event::PROC_EVENT_EXIT:
+        {
+            if(event.event_data.exit.process_pid != event.event_data.exit.process_tgid) break;
+            pid_t pid = event.event_data.exit.process_tgid;
+            //orphans are reparented by the kernel without an event of their own
+            std::vector<pid_t> orphans = tree_->getChildren(pid);
+            tree_->removeProcess(pid);
+            for(const auto& orphan : orphans)
+            {
+                if(Process::readStat(orphan, stat)) tree_->setParent(orphan, stat.ppid);
+                else tree_->removeProcess(orphan);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+ProcConnector::~ProcConnector()
+{
+    close();
+}
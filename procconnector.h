@@ -0,0 +1,41 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <linux/cn_proc.h>
+#include "processtree.h"
+
+class ProcConnector
+{
+private:
+    int fd_ = -1;
+    ProcessTree* tree_;
+    
+    bool subscribe(bool listen);
+    
+public:
+    ProcConnector(ProcessTree* tree): tree_(tree){}
+    ~ProcConnector();
+    bool open();
+    void close();
+    bool isOpen();
+    int getFd();
+    void handleMessages();
+    void handleEvent(const proc_event& event);
+};
@@ -19,20 +19,120 @@
 
 #include <iostream>
 #include <fstream>
-#include <filesystem>
+#include <string_view>
+#include <charconv>
+#include <cstdio>
 #include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
 #include "process.h"
-#include "split.h"
+#include "processtree.h"
+#include "cgroupfreezer.h"
+#include "metrics.h"
 #include "debug.h"
 
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+#ifndef SCHED_IDLE
+#define SCHED_IDLE 5
+#endif
+
+static constexpr int IOPRIO_CLASS_SHIFT = 13;
+static constexpr int IOPRIO_CLASS_BE = 2;
+static constexpr int IOPRIO_CLASS_IDLE = 3;
+static constexpr int IOPRIO_WHO_PROCESS = 1;
+static constexpr unsigned long CAP_SYS_NICE_BIT = 23;
+
+static constexpr size_t STAT_BUFFER_SIZE = 1024;
+static constexpr size_t PATH_BUFFER_SIZE = 64;
+
+static ssize_t readProcFile(int dirFd, const char* path, char* buffer, size_t size)
+{
+    int fd = openat(dirFd, path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return -1;
+    ssize_t length = read(fd, buffer, size);
+    close(fd);
+    return length;
+}
+
+static bool parsePid(std::string_view string, pid_t& pid)
+{
+    if(string.empty()) return false;
+    auto result = std::from_chars(string.data(), string.data()+string.size(), pid);
+    return result.ec == std::errc() && result.ptr == string.data()+string.size();
+}
+
+static std::string_view nextToken(std::string_view& string)
+{
+    size_t start = string.find_first_not_of(' ');
+    if(start == std::string_view::npos)
+    {
+        string = std::string_view();
+        return string;
+    }
+    size_t end = string.find(' ', start);
+    if(end == std::string_view::npos) end = string.size();
+    std::string_view token = string.substr(start, end-start);
+    string.remove_prefix(end);
+    return token;
+}
+
 bool Process::operator==(const Process& in)
 {
-    return pid_ == in.pid_;
+    //a recycled pid has a different start time, only compare when both sides know it
+    return pid_ == in.pid_ && (starttime_ == 0 || in.starttime_ == 0 || starttime_ == in.starttime_);
 }
     
 bool Process::operator!=(const Process& in)
 {
-    return pid_ != in.pid_;
+    return !(*this == in);
+}
+
+bool Process::pidFdAvailable()
+{
+    static const bool available = []()
+    {
+        int fd = syscall(SYS_pidfd_open, getpid(), 0);
+        if(fd < 0) return false;
+        close(fd);
+        return true;
+    }();
+    return available;
+}
+
+bool Process::pin()
+{
+    if(pid_ <= 0) return false;
+    if(pidFd_) return true;
+    readStat();
+    if(!pidFdAvailable()) return false;
+    int fd = syscall(SYS_pidfd_open, pid_, 0);
+    if(fd < 0) return false;
+    pidFd_ = std::shared_ptr<int>(new int(fd), [](int* fd){close(*fd); delete fd;});
+    
+    //the pid may have been recycled between reading the stat file and opening the pidfd
+    ProcStat stat;
+    if(!readStat(pid_, stat) || stat.starttime != starttime_)
+    {
+        pidFd_.reset();
+        return false;
+    }
+    return true;
+}
+
+int Process::getPidFd()
+{
+    return pidFd_ ? *pidFd_ : -1;
 }
 
 pid_t Process::getPid()
@@ -42,134 +142,530 @@ pid_t Process::getPid()
 
 void Process::stop(bool children)
 {
-    if(pid_ > 0)
+    if(children && freezer && freezer->freeze(*this)) return;
+    sendSignal(SIGSTOP, children);
+}
+
+void Process::resume(bool children)
+{
+    //a frozen process can not run on its own, so the whole cgroup is thawed even without children,
+    //thaw fails for leafs that are not frozen, processes stoped by signal in them get SIGCONT
+    if(freezer && freezer->thaw(*this)) return;
+    sendSignal(SIGCONT, children);
+}
+
+bool Process::idleReversible()
+{
+    //leaving SCHED_IDLE is only allowed with CAP_SYS_NICE or a RLIMIT_NICE that allows nice 0
+    static const bool reversible = []()
     {
-        kill(pid_, SIGSTOP);
-        if(children)
+        rlimit limit;
+        if(getrlimit(RLIMIT_NICE, &limit) == 0 && (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= 20)) return true;
+        std::fstream status("/proc/self/status", std::fstream::in);
+        std::string line;
+        while(std::getline(status, line))
         {
-            std::vector<Process> children = getChildren();
-            for(auto& child : children) child.stop(true);
+            if(line.compare(0, 7, "CapEff:") != 0) continue;
+            unsigned long long caps = std::stoull(line.substr(7), nullptr, 16);
+            return (caps & (1ULL << CAP_SYS_NICE_BIT)) != 0;
         }
+        return false;
+    }();
+    return reversible;
+}
+
+std::vector<pid_t> Process::getThreads(pid_t pid)
+{
+    std::vector<pid_t> threads;
+    char path[PATH_BUFFER_SIZE];
+    snprintf(path, sizeof(path), "%d/task", pid);
+    int taskFd = openat(procFd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(taskFd < 0) return threads;
+    DIR* tasks = fdopendir(taskFd);
+    if(tasks == nullptr)
+    {
+        close(taskFd);
+        return threads;
+    }
+    pid_t tid;
+    while(dirent* task = readdir(tasks))
+    {
+        if(parsePid(task->d_name, tid)) threads.push_back(tid);
     }
+    closedir(tasks);
+    return threads;
 }
 
-void Process::resume(bool children)
+void Process::setThreadIdle(pid_t tid, bool idle, std::unordered_map<pid_t, ThreadPriority>& saved)
 {
-    kill(pid_, SIGCONT);
+    //threads with a realtime policy are left alone, they are not ours to demote
+    int policy = sched_getscheduler(tid);
+    sched_param param = {};
+    if(idle && (policy == SCHED_OTHER || policy == SCHED_BATCH))
+    {
+        //an io priority equal to the one derived from the nice value was never set explicitly
+        int ioprio = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, tid);
+        errno = 0;
+        int nice = getpriority(PRIO_PROCESS, tid);
+        if(ioprio < 0 || (errno == 0 && ioprio == ((IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | (nice+20)/5))) ioprio = 0;
+        
+        if(sched_setscheduler(tid, SCHED_IDLE, &param) < 0) return;
+        saved[tid] = {policy, ioprio};
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+    }
+    else if(!idle && policy == SCHED_IDLE)
+    {
+        //threads started while demoted inherited SCHED_IDLE, they get the defaults
+        //class none derives the io priority from the nice value again
+        auto entry = saved.find(tid);
+        ThreadPriority original = entry != saved.end() ? entry->second : ThreadPriority{SCHED_OTHER, 0};
+        sched_setscheduler(tid, original.policy, &param);
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, original.ioprio);
+    }
+}
+
+bool Process::setIdle(bool idle, bool children)
+{
+    if(pid_ <= 0) return false;
+    if(freezer && freezer->setIdle(*this, idle)) return true;
+    if(idle && !idleReversible()) return false;
+    
+    std::vector<pid_t> members({pid_});
     if(children)
     {
-        std::vector<Process> children = getChildren();
-        for(auto& child : children) child.resume(true);
+        std::vector<pid_t> descendants = getDescendants();
+        members.insert(members.end(), descendants.begin(), descendants.end());
+    }
+    std::unordered_map<pid_t, ThreadPriority>& saved = idleThreads_[pid_];
+    for(const auto& pid : members)
+    {
+        std::vector<pid_t> threads = getThreads(pid);
+        for(const auto& tid : threads) setThreadIdle(tid, idle, saved);
     }
+    if(!idle) idleThreads_.erase(pid_);
+    return true;
 }
 
-bool Process::getStoped()
+void Process::forgetIdle()
 {
-    return stoped_;
+    idleThreads_.erase(pid_);
+}
+
+bool Process::throttle(int percent)
+{
+    return freezer && freezer->throttle(*this, percent);
 }
 
-std::vector<std::string> Process::openStatus()
+int Process::deliver(pid_t pid, int sig)
 {
-    std::fstream statusFile;
-    std::vector<std::string> lines;
-    if(pid_ > 0)
+    return signalSink ? signalSink(pid, sig) : kill(pid, sig);
+}
+
+void Process::sendSignal(int sig, bool children)
+{
+    if(pid_ <= 0) return;
+    if(pidFd_ && !signalSink) 
+    {
+        if(syscall(SYS_pidfd_send_signal, *pidFd_, sig, nullptr, 0) < 0) return;
+    }
+    else
     {
-        statusFile.open(std::string("/proc/") + std::to_string(pid_)+ "/status", std::fstream::in);
-        if(statusFile.is_open())
+        deliver(pid_, sig);
+    }
+    if(!children) return;
+    if(signalMode_ != SIGNAL_TREE && signalGroup(sig)) return;
+    
+    uint64_t startTime = Metrics::now();
+    uint64_t signals = 1;
+    if(childrenFileAvailable() && !processTable)
+    {
+        //signal one generation at a time so that every parent is already stopped
+        //before its children are read, this way no fork can slip through
+        std::vector<pid_t> generation = {pid_};
+        std::vector<pid_t> next;
+        while(!generation.empty())
         {
-            std::string statusString((std::istreambuf_iterator<char>(statusFile)),
-            std::istreambuf_iterator<char>());
-            lines = split(statusString);
-            statusFile.close();
+            next.clear();
+            for(const auto& pid : generation) readChildren(pid, next);
+            for(const auto& pid : next) deliver(pid, sig);
+            signals += next.size();
+            generation.swap(next);
+        }
+    }
+    else
+    {
+        std::vector<pid_t> descendants = getDescendants();
+        for(const auto& pid : descendants) deliver(pid, sig);
+        signals += descendants.size();
+    }
+    Metrics::procScan.record(Metrics::now() - startTime);
+    Metrics::signalsPerOperation.record(signals);
+}
+
+bool Process::signalGroup(int sig)
+{
+    //a group or session led by this process is considered private to it, every member of a
+    //session descends from its leader and foreign processes can not join a group from outside
+    ProcStat stat;
+    if(!readStat(pid_, stat)) return false;
+    uint64_t startTime = Metrics::now();
+    uint64_t signals = 0;
+    if(signalMode_ == SIGNAL_GROUP)
+    {
+        if(stat.pgrp != pid_) return false;
+        if(deliver(-stat.pgrp, sig) < 0) return false;
+        signals = 1;
+    }
+    else if(signalMode_ == SIGNAL_SESSION)
+    {
+        if(stat.session != pid_) return false;
+        std::vector<pid_t> members;
+        if(processTable)
+        {
+            members = processTable->getBySession(stat.session);
         }
         else
         {
-            std::cout<<"cant open "<<"/proc/" + std::to_string(pid_)+ "/status"<<std::endl;
+            std::vector<pid_t> pids = getAllProcessPids();
+            for(const auto& pid : pids)
+            {
+                if(pid != pid_ && readStat(pid, stat) && stat.session == pid_) members.push_back(pid);
+            }
+        }
+        for(const auto& pid : members) 
+        {
+            if(pid != pid_) deliver(pid, sig);
         }
+        signals = members.size();
     }
-    return lines;
+    else
+    {
+        return false;
+    }
+    Metrics::procScan.record(Metrics::now() - startTime);
+    Metrics::signalsPerOperation.record(signals);
+    return true;
 }
 
-std::vector<Process> Process::getChildren()
+void Process::setSignalMode(SignalMode mode)
 {
-    std::vector<Process> ret;
-    std::vector<pid_t> processes = getAllProcessPids();
-    for(const auto & pid : processes)
+    signalMode_ = mode;
+}
+
+Process::SignalMode Process::getSignalMode()
+{
+    return signalMode_;
+}
+
+std::vector<pid_t> Process::getDescendants()
+{
+    if(processTable) return processTable->getDescendants(pid_);
+    
+    if(childrenFileAvailable())
     {
-        Process process(pid);
-        if(process.getPPid() == pid_) ret.push_back(process);
+        std::vector<pid_t> descendants;
+        readChildren(pid_, descendants);
+        for(size_t i = 0; i < descendants.size(); ++i) readChildren(descendants[i], descendants);
+        return descendants;
     }
-    return ret;
+    
+    ProcessTree tree;
+    tree.update();
+    return tree.getDescendants(pid_);
 }
 
-std::vector<pid_t> Process::getAllProcessPids()
+bool Process::getStoped()
 {
-    std::vector<pid_t> processes;
-    for(const auto & entry : std::filesystem::directory_iterator("/proc"))
+    return stoped_;
+}
+
+int Process::procFd()
+{
+    if(procFd_ < 0) procFd_ = open(procRoot_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    return procFd_;
+}
+
+bool Process::setProcRoot(const std::string& root)
+{
+    int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd < 0) return false;
+    if(procFd_ >= 0) close(procFd_);
+    procFd_ = fd;
+    procRoot_ = root;
+    childrenFileAvailable_ = -1;
+    return true;
+}
+
+const std::string& Process::getProcRoot()
+{
+    return procRoot_;
+}
+
+bool Process::childrenFileAvailable()
+{
+    if(childrenFileAvailable_ < 0)
     {
-        pid_t pid = convertPid(entry.path().stem());
-        if(pid > 0) processes.push_back(pid);
+        char path[PATH_BUFFER_SIZE];
+        snprintf(path, sizeof(path), "self/task/%d/children", getpid());
+        childrenFileAvailable_ = faccessat(procFd(), path, R_OK, 0) == 0;
     }
-    return processes;
+    return childrenFileAvailable_;
 }
 
-std::string Process::getName()
+bool Process::readChildren(pid_t pid, std::vector<pid_t>& children)
 {
-    if(name_.size() == 0)
+    char path[PATH_BUFFER_SIZE];
+    snprintf(path, sizeof(path), "%d/task", pid);
+    int taskFd = openat(procFd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(taskFd < 0) return false;
+    DIR* tasks = fdopendir(taskFd);
+    if(tasks == nullptr)
+    {
+        close(taskFd);
+        return false;
+    }
+    
+    char buffer[STAT_BUFFER_SIZE];
+    while(dirent* task = readdir(tasks))
     {
-        std::vector<std::string> lines = openStatus();
-        if(lines.size() > 0)
+        if(task->d_name[0] < '0' || task->d_name[0] > '9') continue;
+        snprintf(path, sizeof(path), "%.32s/children", task->d_name);
+        int fd = openat(taskFd, path, O_RDONLY | O_CLOEXEC);
+        if(fd < 0) continue;
+        
+        //the file is a space separated list of pids that may span several reads
+        pid_t child = 0;
+        bool inNumber = false;
+        ssize_t length;
+        while((length = read(fd, buffer, sizeof(buffer))) > 0)
         {
-            std::vector<std::string> tokens = split(lines[0], '\t');
-            if(tokens.size() > 1)
+            for(ssize_t i = 0; i < length; ++i)
             {
-                name_ = tokens[1];
+                if(buffer[i] >= '0' && buffer[i] <= '9')
+                {
+                    child = child*10 + (buffer[i] - '0');
+                    inNumber = true;
+                }
+                else if(inNumber)
+                {
+                    children.push_back(child);
+                    child = 0;
+                    inNumber = false;
+                }
             }
         }
+        if(inNumber) children.push_back(child);
+        close(fd);
     }
-    return name_;
+    closedir(tasks);
+    return true;
 }
 
-std::vector<Process> Process::byName(const std::string& name)
+bool Process::readStat(pid_t pid, ProcStat& stat)
 {
-    std::vector<pid_t> procs = getAllProcessPids();
-    std::vector<Process> retProcs;
-    for(const auto & pid : procs )
+    if(pid <= 0) return false;
+    char path[PATH_BUFFER_SIZE];
+    snprintf(path, sizeof(path), "%d/stat", pid);
+    char buffer[STAT_BUFFER_SIZE];
+    ssize_t length = readProcFile(procFd(), path, buffer, sizeof(buffer));
+    if(length <= 0)
     {
-        Process proc(pid);
-        if(name == proc.getName()) retProcs.push_back(proc);
+        debug("cant open " + procRoot_ + "/" + std::to_string(pid) + "/stat");
+        return false;
     }
-    return retProcs;
+    std::string_view string(buffer, length);
+    
+    //comm may contain spaces and parentheses so it is delimited by the first '(' and the last ')'
+    size_t commStart = string.find('(');
+    size_t commEnd = string.rfind(')');
+    if(commStart == std::string_view::npos || commEnd == std::string_view::npos || commEnd < commStart) return false;
+    std::string_view comm = string.substr(commStart+1, commEnd-commStart-1);
+    size_t commLength = std::min(comm.size(), ProcStat::COMM_LEN-1);
+    comm.copy(stat.comm, commLength);
+    stat.comm[commLength] = '\0';
+    
+    //fields are counted from 3 (state) onwards as documented in proc(5)
+    std::string_view fields = string.substr(commEnd+1);
+    for(int field = 3; field <= 22; ++field)
+    {
+        std::string_view token = nextToken(fields);
+        if(token.empty()) return false;
+        switch(field)
+        {
+            case 3:
+                stat.state = token[0];
+                break;
+            case 4:
+                parsePid(token, stat.ppid);
+                break;
+            case 5:
+                parsePid(token, stat.pgrp);
+                break;
+            case 6:
+                parsePid(token, stat.session);
+                break;
+            case 14:
+                std::from_chars(token.data(), token.data()+token.size(), stat.utime);
+                break;
+            case 15:
+                std::from_chars(token.data(), token.data()+token.size(), stat.stime);
+                break;
+            case 22:
+                std::from_chars(token.data(), token.data()+token.size(), stat.starttime);
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
 }
 
-pid_t Process::convertPid(const std::string& pid)
+void Process::readStat()
 {
-    pid_t ret;
-    try
+    if(statRead_) return;
+    ProcStat stat;
+    if(readStat(pid_, stat))
     {
-        ret = std::stol(pid);
+        name_ = stat.comm;
+        ppid_ = stat.ppid;
+        starttime_ = stat.starttime;
     }
-    catch(const std::invalid_argument& exception) 
+    statRead_ = true;
+}
+
+std::vector<Process> Process::getChildren()
+{
+    std::vector<Process> ret;
+    std::vector<pid_t> pids;
+    if(processTable)
     {
-        debug(exception.what());
-        ret = -1;
+        pids = processTable->getChildren(pid_);
     }
+    else if(childrenFileAvailable())
+    {
+        readChildren(pid_, pids);
+    }
+    else
+    {
+        ProcessTree tree;
+        tree.update();
+        pids = tree.getChildren(pid_);
+    }
+    ret.reserve(pids.size());
+    for(const auto& pid : pids) ret.push_back(Process(pid));
     return ret;
 }
 
-pid_t Process::getPPid()
+std::vector<pid_t> Process::getAllProcessPids()
 {
-    if(ppid_ < 0)
+    std::vector<pid_t> processes;
+    int fd = openat(procFd(), ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd < 0) return processes;
+    DIR* dir = fdopendir(fd);
+    if(dir == nullptr)
     {
-        std::vector<std::string> lines = openStatus();
-        if(lines.size() > 7)
-        {
-           std::vector<std::string> tokens = split(lines[6] , '\t');
-           if(tokens.size() > 1) ppid_ = convertPid(tokens[1]);
-        }
+        close(fd);
+        return processes;
+    }
+    while(dirent* entry = readdir(dir))
+    {
+        pid_t pid;
+        if(parsePid(entry->d_name, pid) && pid > 0) processes.push_back(pid);
     }
+    closedir(dir);
+    return processes;
+}
+
+std::string Process::getName()
+{
+    readStat();
+    return name_;
+}
+
+std::string Process::readFile(const char* name)
+{
+    std::string content;
+    if(pid_ <= 0) return content;
+    char path[PATH_BUFFER_SIZE];
+    snprintf(path, sizeof(path), "%d/%s", pid_, name);
+    int fd = openat(procFd(), path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return content;
+    char buffer[STAT_BUFFER_SIZE];
+    ssize_t length;
+    while((length = read(fd, buffer, sizeof(buffer))) > 0) content.append(buffer, length);
+    close(fd);
+    return content;
+}
+
+std::string Process::getCmdline()
+{
+    std::string cmdline = readFile("cmdline");
+    
+    //arguments are separated by null bytes
+    while(!cmdline.empty() && cmdline.back() == '\0') cmdline.pop_back();
+    for(auto& ch : cmdline) if(ch == '\0') ch = ' ';
+    return cmdline;
+}
+
+long Process::getResidentPages()
+{
+    if(pid_ <= 0) return -1;
+    char path[PATH_BUFFER_SIZE];
+    snprintf(path, sizeof(path), "%d/statm", pid_);
+    char buffer[PATH_BUFFER_SIZE*2];
+    ssize_t length = readProcFile(procFd(), path, buffer, sizeof(buffer));
+    if(length <= 0) return -1;
+    
+    //statm is size resident shared text lib data dt, all in pages
+    std::string_view statm(buffer, length);
+    nextToken(statm);
+    std::string_view resident = nextToken(statm);
+    long pages;
+    auto result = std::from_chars(resident.data(), resident.data()+resident.size(), pages);
+    if(result.ec != std::errc()) return -1;
+    return pages;
+}
+
+bool Process::getExeId(dev_t& dev, ino_t& ino)
+{
+    if(pid_ <= 0) return false;
+    char path[PATH_BUFFER_SIZE];
+    snprintf(path, sizeof(path), "%d/exe", pid_);
+    struct stat exeStat;
+    if(fstatat(procFd(), path, &exeStat, 0) != 0) return false;
+    dev = exeStat.st_dev;
+    ino = exeStat.st_ino;
+    return true;
+}
+
+std::vector<Process> Process::byName(const std::string& name)
+{
+    std::vector<Process> retProcs;
+    if(processTable)
+    {
+        for(const auto& pid : processTable->getByName(name)) retProcs.push_back(Process(pid));
+        return retProcs;
+    }
+    std::vector<pid_t> procs = getAllProcessPids();
+    ProcStat stat;
+    for(const auto & pid : procs )
+    {
+        if(readStat(pid, stat) && name == stat.comm) retProcs.push_back(Process(pid));
+    }
+    return retProcs;
+}
+
+pid_t Process::getPPid()
+{
+    readStat();
     return ppid_;
 }
+
+unsigned long long Process::getStartTime()
+{
+    readStat();
+    return starttime_;
+}
     
 Process::Process(pid_t pidIn): pid_(pidIn)
 {
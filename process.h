@@ -20,34 +20,109 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <memory>
+#include <unordered_map>
 #include <sys/types.h>
 
+class ProcessTree;
+class CgroupFreezer;
+
+struct ProcStat
+{
+    static constexpr size_t COMM_LEN = 16;
+    char comm[COMM_LEN] = {0};
+    char state = 0;
+    pid_t ppid = -1;
+    pid_t pgrp = -1;
+    pid_t session = -1;
+    unsigned long long utime = 0;
+    unsigned long long stime = 0;
+    unsigned long long starttime = 0;
+};
+
 class Process
 {
+public:
+    enum SignalMode
+    {
+        SIGNAL_TREE,
+        SIGNAL_GROUP,
+        SIGNAL_SESSION
+    };
+    
 private:
     pid_t pid_ = -1;
     pid_t ppid_ = -1;
+    unsigned long long starttime_ = 0;
     std::string name_;
     bool stoped_ = false;
+    bool statRead_ = false;
+    SignalMode signalMode_ = SIGNAL_TREE;
+    std::shared_ptr<int> pidFd_;
+    
+    struct ThreadPriority
+    {
+        int policy;
+        int ioprio;
+    };
+    
+    //scheduling of demoted threads as it was before, by the demoted process and thread id
+    inline static std::unordered_map<pid_t, std::unordered_map<pid_t, ThreadPriority>> idleThreads_;
+    
+    inline static std::string procRoot_ = "/proc";
+    inline static int procFd_ = -1;
+    inline static int childrenFileAvailable_ = -1;
     
 private:
-    std::vector<std::string> openStatus();
-    static std::vector<pid_t> getAllProcessPids();
-    static pid_t convertPid(const std::string& pid);
+    void readStat();
+    void sendSignal(int sig, bool children);
+    static int deliver(pid_t pid, int sig);
+    bool signalGroup(int sig);
+    static bool readChildren(pid_t pid, std::vector<pid_t>& children);
+    static std::vector<pid_t> getThreads(pid_t pid);
+    static void setThreadIdle(pid_t tid, bool idle, std::unordered_map<pid_t, ThreadPriority>& saved);
+    static bool childrenFileAvailable();
+    static int procFd();
     
 public:
     
+    typedef int (*SignalSink)(pid_t pid, int sig);
+    
+    inline static const ProcessTree* processTable = nullptr;
+    inline static CgroupFreezer* freezer = nullptr;
+    //replaces kill() for every signal sent, lets benchmarks run against synthetic proc trees
+    inline static SignalSink signalSink = nullptr;
+    
     bool operator==(const Process& in);
     bool operator!=(const Process& in);
     std::string getName();
+    std::string getCmdline();
+    std::string readFile(const char* name);
+    long getResidentPages();
+    bool getExeId(dev_t& dev, ino_t& ino);
+    bool pin();
+    int getPidFd();
+    void setSignalMode(SignalMode mode);
+    SignalMode getSignalMode();
     void stop(bool children = false);
     void resume(bool children = false);
+    bool setIdle(bool idle, bool children = false);
+    void forgetIdle();
+    bool throttle(int percent);
     bool getStoped();
     pid_t getPid();
     pid_t getPPid();
+    unsigned long long getStartTime();
     Process getParent(){return Process(getPPid());}
     std::vector<Process> getChildren();
+    std::vector<pid_t> getDescendants();
     static std::vector<Process> byName(const std::string& name);
+    static std::vector<pid_t> getAllProcessPids();
+    static bool readStat(pid_t pid, ProcStat& stat);
+    static bool pidFdAvailable();
+    static bool idleReversible();
+    static bool setProcRoot(const std::string& root);
+    static const std::string& getProcRoot();
     Process(){}
     Process(pid_t pidIn);
 };
@@ -0,0 +1,185 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <algorithm>
+#include "processtree.h"
+#include "process.h"
+#include "metrics.h"
+
+void ProcessTree::update()
+{
+    uint64_t startTime = Metrics::now();
+    clear();
+    std::vector<pid_t> pids = Process::getAllProcessPids();
+    processes_.reserve(pids.size());
+    ProcStat stat;
+    for(const auto& pid : pids)
+    {
+        if(Process::readStat(pid, stat)) addProcess(pid, stat.ppid, stat.comm, stat.session);
+    }
+    Metrics::procScan.record(Metrics::now() - startTime);
+}
+
+void ProcessTree::clear()
+{
+    processes_.clear();
+    children_.clear();
+    names_.clear();
+}
+
+bool ProcessTree::empty() const
+{
+    return processes_.empty();
+}
+
+bool ProcessTree::contains(pid_t pid) const
+{
+    return processes_.find(pid) != processes_.end();
+}
+
+void ProcessTree::erase(std::vector<pid_t>& pids, pid_t pid)
+{
+    auto search = std::find(pids.begin(), pids.end(), pid);
+    if(search == pids.end()) return;
+    *search = pids.back();
+    pids.pop_back();
+}
+
+void ProcessTree::addProcess(pid_t pid, pid_t ppid, const std::string& name, pid_t session)
+{
+    if(contains(pid)) removeProcess(pid);
+    processes_[pid] = {ppid, session, name};
+    children_[ppid].push_back(pid);
+    names_[name].push_back(pid);
+}
+
+void ProcessTree::removeProcess(pid_t pid)
+{
+    auto search = processes_.find(pid);
+    if(search == processes_.end()) return;
+    auto siblings = children_.find(search->second.ppid);
+    if(siblings != children_.end()) erase(siblings->second, pid);
+    auto orphans = children_.find(pid);
+    if(orphans != children_.end() && orphans->second.empty()) children_.erase(orphans);
+    auto namesakes = names_.find(search->second.name);
+    if(namesakes != names_.end())
+    {
+        erase(namesakes->second, pid);
+        if(namesakes->second.empty()) names_.erase(namesakes);
+    }
+    processes_.erase(search);
+}
+
+void ProcessTree::setParent(pid_t pid, pid_t ppid)
+{
+    auto search = processes_.find(pid);
+    if(search == processes_.end() || search->second.ppid == ppid) return;
+    auto siblings = children_.find(search->second.ppid);
+    if(siblings != children_.end())
+    {
+        erase(siblings->second, pid);
+        if(siblings->second.empty() && !contains(search->second.ppid)) children_.erase(siblings);
+    }
+    search->second.ppid = ppid;
+    children_[ppid].push_back(pid);
+}
+
+void ProcessTree::setName(pid_t pid, const std::string& name)
+{
+    auto search = processes_.find(pid);
+    if(search == processes_.end() || search->second.name == name) return;
+    auto namesakes = names_.find(search->second.name);
+    if(namesakes != names_.end())
+    {
+        erase(namesakes->second, pid);
+        if(namesakes->second.empty()) names_.erase(namesakes);
+    }
+    search->second.name = name;
+    names_[name].push_back(pid);
+}
+
+void ProcessTree::setSession(pid_t pid, pid_t session)
+{
+    auto search = processes_.find(pid);
+    if(search != processes_.end()) search->second.session = session;
+}
+
+pid_t ProcessTree::getSession(pid_t pid) const
+{
+    auto search = processes_.find(pid);
+    if(search != processes_.end()) return search->second.session;
+    else return -1;
+}
+
+std::vector<pid_t> ProcessTree::getBySession(pid_t session) const
+{
+    std::vector<pid_t> members;
+    for(const auto& process : processes_)
+    {
+        if(process.second.session == session) members.push_back(process.first);
+    }
+    return members;
+}
+
+pid_t ProcessTree::getPPid(pid_t pid) const
+{
+    auto search = processes_.find(pid);
+    if(search != processes_.end()) return search->second.ppid;
+    else return -1;
+}
+
+std::string ProcessTree::getName(pid_t pid) const
+{
+    auto search = processes_.find(pid);
+    if(search != processes_.end()) return search->second.name;
+    else return std::string();
+}
+
+std::vector<pid_t> ProcessTree::getChildren(pid_t pid) const
+{
+    auto search = children_.find(pid);
+    if(search != children_.end()) return search->second;
+    else return std::vector<pid_t>();
+}
+
+std::vector<pid_t> ProcessTree::getDescendants(pid_t pid) const
+{
+    std::vector<pid_t> descendants;
+    std::vector<pid_t> stack = {pid};
+    while(!stack.empty())
+    {
+        pid_t parent = stack.back();
+        stack.pop_back();
+        auto search = children_.find(parent);
+        if(search == children_.end()) continue;
+        for(const auto& child : search->second)
+        {
+            descendants.push_back(child);
+            stack.push_back(child);
+        }
+    }
+    return descendants;
+}
+
+std::vector<pid_t> ProcessTree::getByName(const std::string& name) const
+{
+    auto search = names_.find(name);
+    if(search != names_.end()) return search->second;
+    else return std::vector<pid_t>();
+}
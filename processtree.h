@@ -0,0 +1,59 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <sys/types.h>
+
+class ProcessTree
+{
+private:
+    struct Entry
+    {
+        pid_t ppid = -1;
+        pid_t session = -1;
+        std::string name;
+    };
+    
+    std::unordered_map<pid_t, Entry> processes_;
+    std::unordered_map<pid_t, std::vector<pid_t>> children_;
+    std::unordered_map<std::string, std::vector<pid_t>> names_;
+    
+    static void erase(std::vector<pid_t>& pids, pid_t pid);
+    
+public:
+    void update();
+    void clear();
+    bool empty() const;
+    bool contains(pid_t pid) const;
+    void addProcess(pid_t pid, pid_t ppid, const std::string& name, pid_t session = -1);
+    void removeProcess(pid_t pid);
+    void setParent(pid_t pid, pid_t ppid);
+    void setName(pid_t pid, const std::string& name);
+    void setSession(pid_t pid, pid_t session);
+    pid_t getPPid(pid_t pid) const;
+    std::string getName(pid_t pid) const;
+    pid_t getSession(pid_t pid) const;
+    std::vector<pid_t> getChildren(pid_t pid) const;
+    std::vector<pid_t> getDescendants(pid_t pid) const;
+    std::vector<pid_t> getByName(const std::string& name) const;
+    std::vector<pid_t> getBySession(pid_t session) const;
+};
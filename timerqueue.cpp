@@ -0,0 +1,131 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "timerqueue.h"
+#include <iostream>
+#include <cstring>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+static constexpr uint64_t NS_PER_S = 1000000000;
+
+uint64_t TimerQueue::now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec)*NS_PER_S + time.tv_nsec;
+}
+
+TimerQueue::TimerQueue()
+{
+    fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(fd_ < 0) std::cerr<<"Can not create timerfd: "<<strerror(errno)<<'\n';
+}
+
+bool TimerQueue::isOpen()
+{
+    return fd_ >= 0;
+}
+
+int TimerQueue::getFd()
+{
+    return fd_;
+}
+
+TimerQueue::TimerId TimerQueue::add(long secs, long nanosecs, std::function<void()> callback)
+{
+    TimerId id = nextId_++;
+    heap_.push({now() + static_cast<uint64_t>(secs)*NS_PER_S + nanosecs, id});
+    callbacks_[id] = callback;
+    rearm();
+    return id;
+}
+
+bool TimerQueue::cancel(TimerId id)
+{
+    //the heap entry is left in place and skipped once it reaches the top
+    if(callbacks_.erase(id) == 0) return false;
+    if(heap_.size() > 2*callbacks_.size() + 16) compact();
+    return true;
+}
+
+bool TimerQueue::isPending(TimerId id)
+{
+    return callbacks_.find(id) != callbacks_.end();
+}
+
+void TimerQueue::compact()
+{
+    std::vector<Entry> entries;
+    entries.reserve(callbacks_.size());
+    while(!heap_.empty())
+    {
+        if(isPending(heap_.top().id)) entries.push_back(heap_.top());
+        heap_.pop();
+    }
+    heap_ = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>(std::greater<Entry>(), std::move(entries));
+}
+
+void TimerQueue::rearm()
+{
+    while(!heap_.empty() && !isPending(heap_.top().id)) heap_.pop();
+    
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    uint64_t deadline = heap_.empty() ? 0 : heap_.top().deadline;
+    if(deadline == armedDeadline_) return;
+    if(deadline != 0)
+    {
+        spec.it_value.tv_sec = deadline/NS_PER_S;
+        spec.it_value.tv_nsec = deadline%NS_PER_S;
+    }
+    timerfd_settime(fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+    armedDeadline_ = deadline;
+}
+
+void TimerQueue::handleExpired()
+{
+    uint64_t expirations;
+    while(read(fd_, &expirations, sizeof(expirations)) == sizeof(expirations));
+    armedDeadline_ = 0;
+    
+    uint64_t time = now();
+    while(!heap_.empty() && heap_.top().deadline <= time)
+    {
+        Entry entry = heap_.top();
+        heap_.pop();
+        auto search = callbacks_.find(entry.id);
+        if(search == callbacks_.end()) continue;
+        std::function<void()> callback = std::move(search->second);
+        callbacks_.erase(search);
+        callback();
+    }
+    rearm();
+}
+
+size_t TimerQueue::size()
+{
+    return callbacks_.size();
+}
+
+TimerQueue::~TimerQueue()
+{
+    if(fd_ >= 0) close(fd_);
+}
@@ -0,0 +1,62 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#pragma once
+#include <functional>
+#include <queue>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+class TimerQueue
+{
+public:
+    typedef uint64_t TimerId;
+    static constexpr TimerId INVALID_TIMER = 0;
+    
+private:
+    struct Entry
+    {
+        uint64_t deadline;
+        TimerId id;
+        bool operator>(const Entry& in) const {return deadline > in.deadline;}
+    };
+    
+    int fd_ = -1;
+    TimerId nextId_ = 1;
+    uint64_t armedDeadline_ = 0;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap_;
+    std::unordered_map<TimerId, std::function<void()>> callbacks_;
+    
+    void rearm();
+    void compact();
+    
+public:
+    static uint64_t now();
+    
+    TimerQueue();
+    ~TimerQueue();
+    bool isOpen();
+    int getFd();
+    TimerId add(long secs, long nanosecs, std::function<void()> callback);
+    bool cancel(TimerId id);
+    bool isPending(TimerId id);
+    void handleExpired();
+    size_t size();
+};
@@ -23,7 +23,9 @@
 #include <limits.h>
 #include <cstring>
 #include <unistd.h>
+#include <algorithm>
 #include "debug.h"
+#include "metrics.h"
 
 unsigned long XInstance::readProparty(Window wid, Atom atom, unsigned char** prop, int* format)
 {
@@ -31,7 +33,7 @@ unsigned long XInstance::readProparty(Window wid, Atom atom, unsigned char** pro
     unsigned long nitems;
     unsigned long bytes_after;
     
-    XLockDisplay(display);
+    uint64_t startTime = Metrics::now();
     int ret = XGetWindowProperty(
         display, 
         wid, 
@@ -43,7 +45,7 @@ unsigned long XInstance::readProparty(Window wid, Atom atom, unsigned char** pro
         &nitems, 
         &bytes_after,
         prop);
-    XUnlockDisplay(display);
+    Metrics::xRoundTrip.record(Metrics::now() - startTime);
     if (ret != Success) 
     {
         std::cerr<<"XGetWindowProperty failed!\n";
@@ -52,14 +54,8 @@ unsigned long XInstance::readProparty(Window wid, Atom atom, unsigned char** pro
     else return std::min((*format)/8*nitems, XInstance::MAX_BYTES);
 }
     
-Atom XInstance::getAtom(const std::string& atomName)
-{
-    return XInternAtom(display, atomName.c_str(), true);;
-}
-    
 bool XInstance::open(const std::string& xDisplayName)
 {
-    XInitThreads();
     display = XOpenDisplay(xDisplayName.c_str());
     if (display == nullptr) 
     {
@@ -67,27 +63,36 @@ bool XInstance::open(const std::string& xDisplayName)
         return false;
     }
     screen = XDefaultScreen(display);
+#ifdef HAVE_XCB
+    if(!openXcb(xDisplayName)) std::cerr<<"Can not open xcb connection, using Xlib for property reads\n";
+#endif
     
-    atoms.netActiveWindow = getAtom("_NET_ACTIVE_WINDOW");
-    if(atoms.netActiveWindow == 0)
-    {
-        std::cerr<<"_NET_ACTIVE_WINDOW is required\n";
-        return false;
-    }
+    //windows may vanish at any time, errors about them are not fatal
+    defaultHandler = XSetErrorHandler(ignoreErrorHandler);
     
-    atoms.netWmPid = getAtom("_NET_WM_PID");
-    if(atoms.netActiveWindow == 0)
-    {
-        std::cerr<<"_NET_WM_PID is required\n";
-        return false;
-    }
+    char hostName[HOST_NAME_MAX+1]={0};
+    if(gethostname(hostName, HOST_NAME_MAX) != 0) debug("Can't get host name");
+    else hostName_ = hostName;
     
-    atoms.wmClientMachine = getAtom("WM_CLIENT_MACHINE");
-    if(atoms.netActiveWindow == 0)
+    //all atoms are interned in one round trip
+    char* atomNames[] = {const_cast<char*>("_NET_ACTIVE_WINDOW"), const_cast<char*>("_NET_WM_PID"), 
+                         const_cast<char*>("WM_CLIENT_MACHINE"), const_cast<char*>("_NET_CLIENT_LIST")};
+    Atom* atomTargets[] = {&atoms.netActiveWindow, &atoms.netWmPid, &atoms.wmClientMachine, &atoms.netClientList};
+    constexpr int requiredAtoms = 3;
+    Atom internedAtoms[sizeof(atomNames)/sizeof(*atomNames)] = {};
+    uint64_t startTime = Metrics::now();
+    XInternAtoms(display, atomNames, sizeof(atomNames)/sizeof(*atomNames), true, internedAtoms);
+    Metrics::xRoundTrip.record(Metrics::now() - startTime);
+    for(size_t i = 0; i < sizeof(atomNames)/sizeof(*atomNames); ++i)
     {
-        std::cerr<<"  is required\n";
-        return false;
+        if(internedAtoms[i] == None && i < requiredAtoms)
+        {
+            std::cerr<<atomNames[i]<<" is required\n";
+            return false;
+        }
+        *atomTargets[i] = internedAtoms[i];
     }
+    updateClientList();
     
     return true;
 }
@@ -99,9 +104,7 @@ Window XInstance::getActiveWindow()
     unsigned long length = readProparty(RootWindow(display, screen), atoms.netActiveWindow, &data, &format);
     Window wid = 0;
     if(format == 32 && length == 4)  wid = *reinterpret_cast<Window*>(data);
-    XLockDisplay(display);
     XFree(data);
-    XUnlockDisplay(display);
     return wid;
 }
 
@@ -111,50 +114,194 @@ std::vector<Window> XInstance::getTopLevelWindows()
     Window parent_return;
     Window* windows = nullptr;
     unsigned int nwindows;
-    XLockDisplay(display);
+    uint64_t startTime = Metrics::now();
     XQueryTree(display, RootWindow(display, screen), &root_return, &parent_return, &windows, &nwindows);
-    XUnlockDisplay(display);
+    Metrics::xRoundTrip.record(Metrics::now() - startTime);
     std::vector<Window> out;
     out.reserve(nwindows);
     for(unsigned int i = 0; i < nwindows; ++i)
     {
         out.push_back(windows[i]);
     }
-    XLockDisplay(display);
     if(windows != nullptr) XFree(windows); 
-    XUnlockDisplay(display);
     return out;
 }
 
+void XInstance::updateClientList()
+{
+    if(atoms.netClientList == 0) return;
+    unsigned char* data = nullptr;
+    int format = 0;
+    unsigned long length = readProparty(RootWindow(display, screen), atoms.netClientList, &data, &format);
+    if(format != 32 || data == nullptr)
+    {
+        if(data) XFree(data);
+        clientListValid_ = false;
+        return;
+    }
+    
+    //format 32 properties are returned as an array of longs
+    std::unordered_set<Window> windows;
+    Window* list = reinterpret_cast<Window*>(data);
+    for(unsigned long i = 0; i < length/4; ++i) windows.insert(list[i]);
+    XFree(data);
+    
+    for(auto client = clients_.begin(); client != clients_.end();)
+    {
+        Window wid = client->first;
+        ++client;
+        if(windows.find(wid) == windows.end()) removeClient(wid);
+    }
+    std::vector<Window> added;
+    for(const auto& wid : windows)
+    {
+        if(clients_.find(wid) == clients_.end()) added.push_back(wid);
+    }
+    std::vector<pid_t> pids = getPids(added);
+    for(size_t i = 0; i < added.size(); ++i)
+    {
+        clients_[added[i]] = pids[i];
+        if(pids[i] > 0) clientsByPid_[pids[i]].insert(added[i]);
+    }
+    clientListValid_ = true;
+}
+
+void XInstance::addClient(Window wid)
+{
+    pid_t pid = getPid(wid);
+    clients_[wid] = pid;
+    if(pid > 0) clientsByPid_[pid].insert(wid);
+}
+
+void XInstance::removeClient(Window wid)
+{
+    auto client = clients_.find(wid);
+    if(client == clients_.end()) return;
+    auto windows = clientsByPid_.find(client->second);
+    if(windows != clientsByPid_.end())
+    {
+        windows->second.erase(wid);
+        if(windows->second.empty()) clientsByPid_.erase(windows);
+    }
+    clients_.erase(client);
+}
+
+bool XInstance::hasWindow(pid_t pid)
+{
+    if(clientListValid_) return clientsByPid_.find(pid) != clientsByPid_.end();
+    
+    std::vector<pid_t> pids = getPids(getTopLevelWindows());
+    return std::find(pids.begin(), pids.end(), pid) != pids.end();
+}
+
+std::vector<pid_t> XInstance::getClientPids()
+{
+    std::vector<pid_t> pids;
+    if(!clientListValid_) return pids;
+    pids.reserve(clientsByPid_.size());
+    for(const auto& client : clientsByPid_) pids.push_back(client.first);
+    return pids;
+}
+
 void XInstance::flush()
 {
-    XLockDisplay(display);
     XFlush(display);
-    XUnlockDisplay(display);
 }
 
 pid_t XInstance::getPid(Window wid)
 {
-    defaultHandler = XSetErrorHandler(ignoreErrorHandler);
+    return getPids({wid})[0];
+}
+
+std::vector<pid_t> XInstance::getPids(const std::vector<Window>& windows)
+{
+    std::vector<pid_t> pids(windows.size(), -1);
+    std::vector<Window> uncached;
+    std::vector<size_t> uncachedIndices;
+    for(size_t i = 0; i < windows.size(); ++i)
+    {
+        auto search = pidCache_.find(windows[i]);
+        if(search != pidCache_.end()) 
+        {
+            pids[i] = search->second;
+        }
+        else
+        {
+            uncached.push_back(windows[i]);
+            uncachedIndices.push_back(i);
+        }
+    }
+    if(uncached.empty()) return pids;
+    
+    //PropertyNotify and DestroyNotify of these windows are needed to invalidate the cache
+    for(const auto& wid : uncached) XSelectInput(display, wid, PropertyChangeMask | StructureNotifyMask);
+#ifdef HAVE_XCB
+    //a second connection may have its reads handled before the selects, a change in between would never be reported
+    if(xcb_ && !sharedXcb_) XSync(display, false);
+#endif
+    
+    std::vector<pid_t> queried = queryPids(uncached);
+    for(size_t i = 0; i < uncached.size(); ++i)
+    {
+        pidCache_[uncached[i]] = queried[i];
+        pids[uncachedIndices[i]] = queried[i];
+    }
+    return pids;
+}
+
+std::vector<pid_t> XInstance::queryPids(const std::vector<Window>& windows)
+{
+#ifdef HAVE_XCB
+    if(xcb_) return queryPidsXcb(windows);
+#endif
+    std::vector<pid_t> pids;
+    pids.reserve(windows.size());
+    for(const auto& wid : windows) pids.push_back(queryPid(wid));
+    return pids;
+}
+
+void XInstance::handleEvent(const XEvent& event)
+{
+    if(event.type == DestroyNotify)
+    {
+        pidCache_.erase(event.xdestroywindow.window);
+        removeClient(event.xdestroywindow.window);
+    }
+    else if(event.type == PropertyNotify && 
+        (event.xproperty.atom == atoms.netWmPid || event.xproperty.atom == atoms.wmClientMachine))
+    {
+        pidCache_.erase(event.xproperty.window);
+        if(clients_.find(event.xproperty.window) != clients_.end())
+        {
+            removeClient(event.xproperty.window);
+            addClient(event.xproperty.window);
+        }
+    }
+    else if(event.type == PropertyNotify && event.xproperty.atom == atoms.netClientList && 
+        event.xproperty.window == RootWindow(display, screen))
+    {
+        updateClientList();
+    }
+}
+
+pid_t XInstance::queryPid(Window wid)
+{
     XTextProperty xWidHostNameTextProperty;
+    xWidHostNameTextProperty.value = nullptr;
     bool ret;
-    XLockDisplay(display);
+    uint64_t startTime = Metrics::now();
     ret = XGetTextProperty(display, wid, &xWidHostNameTextProperty, atoms.wmClientMachine);
-    XUnlockDisplay(display);
+    Metrics::xRoundTrip.record(Metrics::now() - startTime);
     if (!ret) 
     {
         char errorString[1024];
         XGetErrorText(display, ret, errorString, 1024);
         debug("XGetWMClientMachine failed! " + std::string(errorString));
-        if(!ignoreClientMachine) 
-        {
-            XSetErrorHandler(defaultHandler);
-            return -1;
-        }
+        if(!ignoreClientMachine) return -1;
     }
     char** xWidHostNameStringList = nullptr;
-    int nStrings;
-    ret = XTextPropertyToStringList(&xWidHostNameTextProperty, &xWidHostNameStringList, &nStrings);
+    int nStrings = 0;
+    if(ret) ret = XTextPropertyToStringList(&xWidHostNameTextProperty, &xWidHostNameStringList, &nStrings);
     if (!ret || nStrings == 0) 
     {
         char errorString[1024];
@@ -162,22 +309,13 @@ pid_t XInstance::getPid(Window wid)
         debug("XTextPropertyToStringList failed! " + std::string(errorString));
         if(!ignoreClientMachine) 
         {
-            XSetErrorHandler(defaultHandler);
-            return -1;
-        }
-    }
-    char hostName[HOST_NAME_MAX+1]={0};
-    if(gethostname(hostName, HOST_NAME_MAX) != 0)
-    {
-        debug("Can't get host name");
-        if(!ignoreClientMachine) 
-        {
-            XSetErrorHandler(defaultHandler);
+            if(xWidHostNameStringList) XFreeStringList(xWidHostNameStringList);
+            if(xWidHostNameTextProperty.value) XFree(xWidHostNameTextProperty.value);
             return -1;
         }
     }
     pid_t pid = -1;
-    if(ignoreClientMachine || strcmp(hostName, xWidHostNameStringList[0]) == 0 )
+    if(ignoreClientMachine || (!hostName_.empty() && hostName_ == xWidHostNameStringList[0]))
     {
         unsigned char* data = nullptr;
         int format;
@@ -191,7 +329,7 @@ pid_t XInstance::getPid(Window wid)
         debug("Window "+std::to_string(wid)+" is a remote window");
     }
     if(xWidHostNameStringList) XFreeStringList(xWidHostNameStringList);
-    XSetErrorHandler(defaultHandler);
+    if(xWidHostNameTextProperty.value) XFree(xWidHostNameTextProperty.value);
     return pid;
 }
 
@@ -204,7 +342,8 @@ int XInstance::ignoreErrorHandler(Display* display, XErrorEvent* xerror)
 
  XInstance::~XInstance()
  {
-     XLockDisplay(display);
+#ifdef HAVE_XCB
+     closeXcb();
+#endif
      if(display) XCloseDisplay(display);
-     XUnlockDisplay(display);
  }
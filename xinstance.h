@@ -21,12 +21,21 @@
 #include <X11/Xlib.h>
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#ifdef HAVE_XCB
+#include <xcb/xcb.h>
+#endif
+#ifdef HAVE_X11_XCB
+#include <X11/Xlib-xcb.h>
+#endif
 
 struct Atoms
 {
     Atom netActiveWindow = 0;
     Atom netWmPid = 0;
     Atom wmClientMachine = 0;
+    Atom netClientList = 0;
 };
 
 class XInstance
@@ -45,8 +54,26 @@ public:
     
 private:
     
+    std::string hostName_;
+    std::unordered_map<Window, pid_t> pidCache_;
+    std::unordered_map<Window, pid_t> clients_;
+    std::unordered_map<pid_t, std::unordered_set<Window>> clientsByPid_;
+    bool clientListValid_ = false;
+#ifdef HAVE_XCB
+    xcb_connection_t* xcb_ = nullptr;
+    bool sharedXcb_ = false;
+    
+    bool openXcb(const std::string& xDisplayName);
+    void closeXcb();
+    std::vector<pid_t> queryPidsXcb(const std::vector<Window>& windows);
+#endif
+    
+    pid_t queryPid(Window wid);
+    std::vector<pid_t> queryPids(const std::vector<Window>& windows);
+    void addClient(Window wid);
+    void removeClient(Window wid);
+    void updateClientList();
     unsigned long readProparty(Window wid, Atom atom, unsigned char** prop, int* format);
-    Atom getAtom(const std::string& atomName);
     static int ignoreErrorHandler(Display* display, XErrorEvent* xerror);
     
 public:
@@ -55,6 +82,10 @@ public:
     bool open(const std::string& xDisplayName);
     Window getActiveWindow();
     pid_t getPid(Window wid);
+    std::vector<pid_t> getPids(const std::vector<Window>& windows);
+    void handleEvent(const XEvent& event);
     std::vector<Window> getTopLevelWindows();
+    bool hasWindow(pid_t pid);
+    std::vector<pid_t> getClientPids();
     void flush();
 };
@@ -0,0 +1,97 @@
+/**
+ * Sigstoped
+ * Copyright (C) 2020 Carl Klemm
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 3 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "xinstance.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <limits.h>
+#include "debug.h"
+#include "metrics.h"
+
+bool XInstance::openXcb(const std::string& xDisplayName)
+{
+#ifdef HAVE_X11_XCB
+    //on the connection of Xlib, requests buffered by Xlib are sent before the ones made here
+    xcb_ = XGetXCBConnection(display);
+    sharedXcb_ = xcb_ != nullptr;
+    if(sharedXcb_) return true;
+#endif
+    xcb_ = xcb_connect(xDisplayName.c_str(), nullptr);
+    if(xcb_connection_has_error(xcb_))
+    {
+        xcb_disconnect(xcb_);
+        xcb_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void XInstance::closeXcb()
+{
+    if(xcb_ && !sharedXcb_) xcb_disconnect(xcb_);
+    xcb_ = nullptr;
+    sharedXcb_ = false;
+}
+
+std::vector<pid_t> XInstance::queryPidsXcb(const std::vector<Window>& windows)
+{
+    uint64_t startTime = Metrics::now();
+    //send every request before waiting on the first reply so that the whole batch costs one round trip
+    std::vector<xcb_get_property_cookie_t> machineCookies;
+    std::vector<xcb_get_property_cookie_t> pidCookies;
+    machineCookies.reserve(windows.size());
+    pidCookies.reserve(windows.size());
+    for(const auto& wid : windows)
+    {
+        machineCookies.push_back(xcb_get_property(xcb_, false, wid, atoms.wmClientMachine, 
+                                                  XCB_GET_PROPERTY_TYPE_ANY, 0, HOST_NAME_MAX));
+        pidCookies.push_back(xcb_get_property(xcb_, false, wid, atoms.netWmPid, 
+                                              XCB_GET_PROPERTY_TYPE_ANY, 0, 1));
+    }
+    xcb_flush(xcb_);
+    
+    std::vector<pid_t> pids(windows.size(), -1);
+    for(size_t i = 0; i < windows.size(); ++i)
+    {
+        xcb_generic_error_t* error = nullptr;
+        xcb_get_property_reply_t* machineReply = xcb_get_property_reply(xcb_, machineCookies[i], &error);
+        free(error);
+        error = nullptr;
+        xcb_get_property_reply_t* pidReply = xcb_get_property_reply(xcb_, pidCookies[i], &error);
+        free(error);
+        
+        bool local = ignoreClientMachine;
+        if(!local && machineReply && machineReply->format == 8 && xcb_get_property_value_length(machineReply) > 0)
+        {
+            const char* machine = reinterpret_cast<const char*>(xcb_get_property_value(machineReply));
+            size_t length = strnlen(machine, xcb_get_property_value_length(machineReply));
+            local = !hostName_.empty() && hostName_.compare(0, std::string::npos, machine, length) == 0;
+            if(!local) debug("Window "+std::to_string(windows[i])+" is a remote window");
+        }
+        
+        if(local && pidReply && pidReply->format == 32 && xcb_get_property_value_length(pidReply) == 4)
+            pids[i] = *reinterpret_cast<uint32_t*>(xcb_get_property_value(pidReply));
+        
+        free(machineReply);
+        free(pidReply);
+    }
+    Metrics::xRoundTrip.record(Metrics::now() - startTime);
+    return pids;
+}